@@ -0,0 +1,79 @@
+#pragma once
+
+#include "nlohmann/json.hpp"
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+
+#include <cstddef>
+
+struct BenchResult
+{
+    std::string name;
+    std::size_t ops; // Per repetition
+    std::size_t repetitions;
+    double mean_ns; // Per op
+    double stddev_ns;
+    double min_ns;
+    double median_ns;
+};
+
+struct BenchConfig
+{
+    std::size_t warmup = 3;
+    std::size_t repetitions = 15;
+};
+
+// Times fn(), which performs `ops` operations, after some untimed warmup runs
+template<typename Fn>
+BenchResult measure(const std::string &name, std::size_t ops, Fn fn, const BenchConfig &config)
+{
+    for (std::size_t i = 0; i < config.warmup; ++i)
+    {
+        fn();
+    }
+
+    std::vector<double> samples;
+    for (std::size_t i = 0; i < config.repetitions; ++i)
+    {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        samples.push_back(elapsed.count() / ops);
+    }
+
+    double mean = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+    double variance = 0.0;
+    for (double sample : samples)
+    {
+        variance += (sample - mean) * (sample - mean);
+    }
+    variance /= samples.size();
+    std::sort(samples.begin(), samples.end());
+    return BenchResult{name, ops, samples.size(), mean, std::sqrt(variance),
+        samples.front(), samples[samples.size() / 2]};
+}
+
+inline nlohmann::json to_json(const BenchResult &result)
+{
+    return nlohmann::json{
+        {"name", result.name}, {"ops", result.ops}, {"repetitions", result.repetitions},
+        {"mean_ns", result.mean_ns}, {"stddev_ns", result.stddev_ns},
+        {"min_ns", result.min_ns}, {"median_ns", result.median_ns}
+    };
+}
+
+// Keeps a value alive so the measured work is not optimised away
+template<typename T>
+inline void do_not_optimize(const T &value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+std::vector<BenchResult> run_micro_benchmarks(const std::string &rom_path, const BenchConfig &config);
+nlohmann::json run_workload_benchmarks(const std::string &spec_path, const BenchConfig &config);
+bool check_regressions(const nlohmann::json &results, const nlohmann::json &baseline, double threshold);
@@ -0,0 +1,132 @@
+#include "bench.h"
+
+#include "nlohmann/json.hpp"
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <exception>
+#include <stdexcept>
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Must provide a suite argument" << std::endl;
+        return 1;
+    }
+
+    const std::string suite = argv[1];
+    BenchConfig config;
+    if (suite == "workload")
+    {
+        // Each repetition is a whole run in its own process
+        config.warmup = 1;
+        config.repetitions = 3;
+    }
+    std::string rom_path = "roms/Donkey Kong (USA) (Rev 1) (e-Reader Edition).nes";
+    std::string workload_path = "bench/workloads.json";
+    std::string out_path;
+    std::string baseline_path;
+    double threshold = 0.05;
+    // A malformed number is a usage error (1) rather than an uncaught exception
+    std::string arg;
+    try
+    {
+        for (int i = 2; i < argc; ++i)
+        {
+            arg = argv[i];
+            if (arg == "--warmup" && i + 1 < argc)
+            {
+                config.warmup = std::stoul(argv[++i]);
+            }
+            else if (arg == "--repetitions" && i + 1 < argc)
+            {
+                config.repetitions = std::stoul(argv[++i]);
+            }
+            else if (arg == "--out" && i + 1 < argc)
+            {
+                out_path = argv[++i];
+            }
+            else if (arg == "--baseline" && i + 1 < argc)
+            {
+                baseline_path = argv[++i];
+            }
+            else if (arg == "--threshold" && i + 1 < argc)
+            {
+                threshold = std::stod(argv[++i]);
+            }
+            else
+            {
+                rom_path = arg;
+                workload_path = arg;
+            }
+        }
+    }
+    catch (const std::logic_error &)
+    {
+        std::cerr << "Invalid value for " << arg << std::endl;
+        return 1;
+    }
+    if (config.repetitions == 0)
+    {
+        std::cerr << "Need at least one repetition" << std::endl;
+        return 1;
+    }
+
+    nlohmann::json report;
+    bool regressed = false;
+    // A workload that fails to load or run is an error (1), distinct from a
+    // regression (2)
+    try
+    {
+        if (suite == "micro")
+        {
+            report["suite"] = "micro";
+            report["warmup"] = config.warmup;
+            report["repetitions"] = config.repetitions;
+            report["results"] = nlohmann::json::array();
+            for (const BenchResult &result : run_micro_benchmarks(rom_path, config))
+            {
+                report["results"].push_back(to_json(result));
+            }
+        }
+        else if (suite == "workload")
+        {
+            report["suite"] = "workload";
+            report["warmup"] = config.warmup;
+            report["repetitions"] = config.repetitions;
+            report["results"] = run_workload_benchmarks(workload_path, config);
+            if (!baseline_path.empty())
+            {
+                std::ifstream baseline_file(baseline_path);
+                if (!baseline_file.is_open())
+                {
+                    std::cerr << "Failed to open baseline " << baseline_path << std::endl;
+                    return 1;
+                }
+                regressed = check_regressions(report["results"], nlohmann::json::parse(baseline_file), threshold);
+            }
+        }
+        else
+        {
+            std::cerr << "Unknown suite " << argv[1] << std::endl;
+            return 1;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    if (out_path.empty())
+    {
+        std::cout << report.dump(2) << std::endl;
+    }
+    else
+    {
+        std::ofstream(out_path) << report.dump(2) << std::endl;
+    }
+    return regressed ? 2 : 0;
+}
@@ -0,0 +1,210 @@
+#include "bench.h"
+#include "nes.h"
+#include "cpu.h"
+#include "bus.h"
+#include "ppu.h"
+#include "mem.h"
+#include "opcodes.h"
+#include "framebuffer.h"
+#include "addressmappeddevice.h"
+
+#include <array>
+#include <vector>
+#include <string>
+#include <cstdio>
+
+// Returns the same byte for every read and ignores writes, so a CPU fetching
+// from it executes one opcode forever, whatever the operands do.
+class FilledMem: public AddressMappedDevice
+{
+private:
+    uint8_t fill;
+public:
+    FilledMem(uint8_t fill) :
+        fill(fill)
+    {}
+
+    uint8_t get(uint16_t addr)
+    {
+        return fill;
+    }
+
+    void set(uint16_t addr, uint8_t val)
+    {}
+};
+
+static constexpr std::size_t BUS_OPS = 1<<16;
+static constexpr std::size_t CPU_CYCLES = 1<<15;
+static constexpr std::size_t PPU_SCANLINES = 262;
+static constexpr std::size_t PPU_FRAMES = 4;
+static constexpr std::size_t FRAMEBUFFER_FRAMES = 16;
+
+static void bench_bus(const std::string &rom_path, const BenchConfig &config, std::vector<BenchResult> &results)
+{
+    NES nes(nullptr, rom_path);
+    Bus *bus = nes.cpu_bus_ref();
+
+    struct Region
+    {
+        const char *name;
+        uint16_t base;
+        uint16_t mask;
+        bool writable;
+    };
+    // The PPU and controller registers are left out since accessing them has side effects
+    static constexpr Region regions[] = {
+        {"ram", 0x0000, 0x07FF, true},
+        {"prg_ram", 0x6000, 0x1FFF, true},
+        {"prg_rom", 0x8000, 0x7FFF, false}
+    };
+
+    for (const Region &region : regions)
+    {
+        results.push_back(measure(std::string("bus.get.") + region.name, BUS_OPS, [&]()
+        {
+            uint8_t sum = 0;
+            for (std::size_t i = 0; i < BUS_OPS; ++i)
+            {
+                sum += bus->get(region.base + ((i * 7) & region.mask));
+            }
+            do_not_optimize(sum);
+        }, config));
+
+        if (!region.writable) continue;
+        results.push_back(measure(std::string("bus.set.") + region.name, BUS_OPS, [&]()
+        {
+            for (std::size_t i = 0; i < BUS_OPS; ++i)
+            {
+                bus->set(region.base + ((i * 7) & region.mask), i);
+            }
+        }, config));
+    }
+}
+
+// ns per CPU::clock_cycle, per opcode and averaged over each addressing mode
+static void bench_cpu(const BenchConfig &config, std::vector<BenchResult> &results)
+{
+    std::array<std::vector<BenchResult>, AddressingMode::ADDRESSING_MODE_COUNT> by_mode;
+    for (int opcode = 0; opcode < 256; ++opcode)
+    {
+        const OpcodeInfo &info = opcode_info(opcode);
+        if (!info.mnemonic) continue;
+
+        FilledMem mem(opcode);
+        Bus bus;
+        bus.set_logging(false);
+        bus.map_device(0x0000, 0xFFFF, &mem);
+        CPU cpu;
+        cpu.attach_bus(&bus);
+
+        char name[32];
+        std::snprintf(name, sizeof(name), "cpu.opcode.%02X.%s", opcode, info.mnemonic);
+        BenchResult result = measure(name, CPU_CYCLES, [&]()
+        {
+            for (std::size_t i = 0; i < CPU_CYCLES; ++i)
+            {
+                cpu.clock_cycle();
+            }
+        }, config);
+        results.push_back(result);
+        by_mode[info.mode].push_back(result);
+    }
+
+    // Statistics here are across the opcodes of each mode
+    for (int mode = 0; mode < AddressingMode::ADDRESSING_MODE_COUNT; ++mode)
+    {
+        std::vector<double> means;
+        for (const BenchResult &result : by_mode[mode])
+        {
+            means.push_back(result.mean_ns);
+        }
+        if (means.empty()) continue;
+
+        double mean = std::accumulate(means.begin(), means.end(), 0.0) / means.size();
+        double variance = 0.0;
+        for (double m : means)
+        {
+            variance += (m - mean) * (m - mean);
+        }
+        std::sort(means.begin(), means.end());
+        BenchResult summary{std::string("cpu.mode.") + addressing_mode_name(AddressingMode(mode)),
+            CPU_CYCLES, config.repetitions * means.size(), mean, std::sqrt(variance / means.size()),
+            means.front(), means[means.size() / 2]};
+        results.push_back(summary);
+    }
+}
+
+static void bench_ppu(const BenchConfig &config, std::vector<BenchResult> &results)
+{
+    Mem<1<<13> chr;
+    Mem<1<<12> vram;
+    Mem<1<<8> palette;
+    for (unsigned int i = 0; i < (1<<13); ++i)
+    {
+        chr.set(i, (i * 37) ^ (i >> 3));
+    }
+    for (unsigned int i = 0; i < (1<<12); ++i)
+    {
+        vram.set(i, i);
+    }
+
+    Bus bus;
+    bus.set_logging(false);
+    bus.map_device(0x0000, 0x1FFF, &chr);
+    bus.map_device(0x2000, 0x3EFF, &vram);
+    bus.map_device(0x3F00, 0x3FFF, &palette);
+    PPU ppu;
+    ppu.attach_bus(&bus);
+
+    results.push_back(measure("ppu.scanline", PPU_SCANLINES, [&]()
+    {
+        for (std::size_t i = 0; i < PPU_SCANLINES * DOTS_PER_LINE; ++i)
+        {
+            ppu.clock_cycle();
+        }
+    }, config));
+
+    results.push_back(measure("ppu.frame", PPU_FRAMES, [&]()
+    {
+        for (std::size_t i = 0; i < PPU_FRAMES; ++i)
+        {
+            do
+            {
+                ppu.clock_cycle();
+            }
+            while (!ppu.frame_complete());
+        }
+    }, config));
+}
+
+static void bench_framebuffer(const BenchConfig &config, std::vector<BenchResult> &results)
+{
+    PPU::Display display{};
+    for (int x = 0; x < RESOLUTION_X; ++x)
+    {
+        for (int y = 0; y < RESOLUTION_Y; ++y)
+        {
+            display[x][y] = (x ^ y) & 0x3;
+        }
+    }
+    std::vector<uint32_t> pixels(RESOLUTION_X * RESOLUTION_Y);
+
+    results.push_back(measure("framebuffer.convert", FRAMEBUFFER_FRAMES, [&]()
+    {
+        for (std::size_t i = 0; i < FRAMEBUFFER_FRAMES; ++i)
+        {
+            convert_framebuffer(display, pixels.data());
+            do_not_optimize(pixels[i]);
+        }
+    }, config));
+}
+
+std::vector<BenchResult> run_micro_benchmarks(const std::string &rom_path, const BenchConfig &config)
+{
+    std::vector<BenchResult> results;
+    bench_bus(rom_path, config, results);
+    bench_cpu(config, results);
+    bench_ppu(config, results);
+    bench_framebuffer(config, results);
+    return results;
+}
@@ -0,0 +1,184 @@
+#include "bench.h"
+#include "nes.h"
+#include "movie.h"
+
+#include <stdexcept>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <memory>
+#include <chrono>
+
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+struct Workload
+{
+    std::string name;
+    std::string rom;
+    std::string movie; // Empty for no input
+    uint64_t frames;
+};
+
+struct WorkloadRun
+{
+    bool ok;
+    double seconds;
+    uint64_t frames;
+    uint64_t cycles;
+    long peak_rss_kb;
+};
+
+static std::vector<Workload> read_workloads(const std::string &spec_path)
+{
+    std::ifstream file(spec_path);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Failed to open workload file: " + spec_path);
+    }
+    nlohmann::json spec = nlohmann::json::parse(file);
+
+    std::vector<Workload> workloads;
+    for (const auto &entry : spec["workloads"])
+    {
+        workloads.push_back(Workload{
+            entry["name"].get<std::string>(),
+            entry["rom"].get<std::string>(),
+            entry.value("movie", std::string()),
+            entry["frames"].get<uint64_t>()
+        });
+    }
+    return workloads;
+}
+
+// Emulates the workload from power-on. Movie input makes every run identical.
+static WorkloadRun run_workload(const Workload &workload)
+{
+    NES nes(nullptr, workload.rom);
+    std::unique_ptr<Movie> movie;
+    if (!workload.movie.empty())
+    {
+        movie = std::make_unique<Movie>(workload.movie);
+        nes.play_movie(movie.get());
+    }
+    nes.reset();
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < workload.frames; ++i)
+    {
+        nes.step_frame();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return WorkloadRun{true, elapsed.count(), workload.frames, nes.get_cycles(), usage.ru_maxrss};
+}
+
+// Runs in a child process so peak RSS belongs to this workload alone
+static WorkloadRun run_isolated(const Workload &workload)
+{
+    WorkloadRun run{false, 0.0, 0, 0, 0};
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        return run;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        close(fds[0]);
+        try
+        {
+            run = run_workload(workload);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << workload.name << ": " << e.what() << std::endl;
+        }
+        ssize_t written = write(fds[1], &run, sizeof(run));
+        _exit(written == sizeof(run) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    if (pid > 0)
+    {
+        if (read(fds[0], &run, sizeof(run)) != sizeof(run))
+        {
+            run.ok = false;
+        }
+        waitpid(pid, nullptr, 0);
+    }
+    close(fds[0]);
+    return run;
+}
+
+nlohmann::json run_workload_benchmarks(const std::string &spec_path, const BenchConfig &config)
+{
+    nlohmann::json results = nlohmann::json::array();
+    for (const Workload &workload : read_workloads(spec_path))
+    {
+        for (std::size_t i = 0; i < config.warmup; ++i)
+        {
+            run_isolated(workload);
+        }
+
+        std::vector<WorkloadRun> runs;
+        for (std::size_t i = 0; i < config.repetitions; ++i)
+        {
+            WorkloadRun run = run_isolated(workload);
+            if (!run.ok)
+            {
+                throw std::runtime_error("Workload " + workload.name + " failed");
+            }
+            runs.push_back(run);
+        }
+
+        // The median run by time is reported; peak RSS is the worst seen
+        std::sort(runs.begin(), runs.end(), [](const WorkloadRun &a, const WorkloadRun &b)
+        {
+            return a.seconds < b.seconds;
+        });
+        const WorkloadRun &median = runs[runs.size() / 2];
+        long peak_rss_kb = 0;
+        for (const WorkloadRun &run : runs)
+        {
+            peak_rss_kb = std::max(peak_rss_kb, run.peak_rss_kb);
+        }
+
+        results.push_back(nlohmann::json{
+            {"name", workload.name}, {"frames", median.frames}, {"repetitions", runs.size()},
+            {"seconds", median.seconds},
+            {"fps", median.frames / median.seconds},
+            {"cycles_per_second", median.cycles / median.seconds},
+            {"peak_rss_kb", peak_rss_kb}
+        });
+    }
+    return results;
+}
+
+// A workload regresses when its fps falls more than `threshold` (a fraction)
+// below the baseline's. Workloads missing from the baseline are skipped.
+bool check_regressions(const nlohmann::json &results, const nlohmann::json &baseline, double threshold)
+{
+    bool regressed = false;
+    for (const auto &result : results)
+    {
+        for (const auto &base : baseline["results"])
+        {
+            if (base["name"] != result["name"]) continue;
+
+            double fps = result["fps"].get<double>();
+            double base_fps = base["fps"].get<double>();
+            double change = (fps - base_fps) / base_fps;
+            bool slower = change < -threshold;
+            regressed |= slower;
+            std::cerr << (slower ? "REGRESSION " : "ok         ") << result["name"].get<std::string>()
+                      << ": " << fps << " fps vs " << base_fps << " (" << change * 100 << "%)" << std::endl;
+        }
+    }
+    return regressed;
+}
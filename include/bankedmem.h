@@ -0,0 +1,99 @@
+#pragma once
+
+#include "addressmappeddevice.h"
+#include "dirtypages.h"
+
+#include <array>
+
+#include <cstddef>
+#include <cstdint>
+
+// Address window split into fixed-size slots that point at externally owned
+// banks. Bank switching only swaps slot pointers, so reads stay a single load.
+// With PAGE_SIZE set, writes mark dirty pages of the RAM given to track_ram,
+// by offset into that RAM rather than window address, so mirrored and
+// switched banks are tracked correctly. The bitmap is a private base, so
+// it takes no space with tracking off.
+template<unsigned int SLOTS, unsigned int SLOT_SIZE, unsigned int PAGE_SIZE = 0>
+class BankedMem: public AddressMappedDevice, private DirtyPages<PAGE_SIZE>
+{
+public:
+    static constexpr unsigned int BANKS = SLOTS;
+    static constexpr unsigned int BANK_SIZE = SLOT_SIZE;
+    static constexpr unsigned int SIZE = BANKS * BANK_SIZE;
+    using Dirty = DirtyPages<PAGE_SIZE>;
+private:
+    std::array<const uint8_t *, BANKS> read_banks;
+    std::array<uint8_t *, BANKS> write_banks; // nullptr for read-only banks
+    AddressMappedDevice *register_port; // Receives writes to read-only banks
+
+    const uint8_t *ram_base;
+    std::array<std::size_t, BANKS> write_offsets; // Of each RAM bank into ram_base
+public:
+    BankedMem() :
+        Dirty(), read_banks{}, write_banks{}, register_port{nullptr},
+        ram_base{nullptr}, write_offsets{}
+    {}
+
+    // Call before mapping any RAM banks
+    void track_ram(const uint8_t *base, std::size_t size)
+    {
+        ram_base = base;
+        Dirty::resize(size);
+    }
+
+    Dirty *dirty_ref()
+    {
+        return this;
+    }
+
+    void attach_register_port(AddressMappedDevice *port)
+    {
+        register_port = port;
+    }
+
+    void map_rom_bank(unsigned int slot, const uint8_t *data)
+    {
+        read_banks[slot] = data;
+        write_banks[slot] = nullptr;
+    }
+
+    void map_ram_bank(unsigned int slot, uint8_t *data)
+    {
+        read_banks[slot] = data;
+        write_banks[slot] = data;
+        if constexpr (Dirty::ENABLED)
+        {
+            write_offsets[slot] = data - ram_base;
+        }
+    }
+
+    const uint8_t *bank_ref(unsigned int slot) const
+    {
+        return read_banks[slot];
+    }
+
+    uint8_t get(uint16_t addr)
+    {
+        addr %= SIZE;
+        return read_banks[addr / BANK_SIZE][addr % BANK_SIZE];
+    }
+
+    void set(uint16_t addr, uint8_t val)
+    {
+        addr %= SIZE;
+        uint8_t *bank = write_banks[addr / BANK_SIZE];
+        if (bank)
+        {
+            bank[addr % BANK_SIZE] = val;
+            if constexpr (Dirty::ENABLED)
+            {
+                Dirty::mark(write_offsets[addr / BANK_SIZE] + addr % BANK_SIZE);
+            }
+        }
+        else if (register_port)
+        {
+            register_port->set(addr, val);
+        }
+    }
+};
@@ -1,8 +1,11 @@
 #pragma once
 
+#include "heatmap.h"
+
 #include "nlohmann/json.hpp"
 
 #include <vector>
+#include <memory>
 
 #include <cstdint>
 
@@ -34,13 +37,19 @@ private:
     std::vector<Mapping> mappings;
     std::vector<BusOperation> operations;
     std::vector<int> conflict_log;
+    bool logging;
+    std::vector<std::unique_ptr<CountingDevice>> counting_devices;
 public:
     Bus();
+    void reset();
+    void set_logging(bool enabled);
     void map_device(uint16_t start, uint16_t end, AddressMappedDevice *device);
+    void set_heatmap(AccessHeatmap *heatmap);
     void start_cycle();
     uint8_t get(uint16_t addr);
     void set(uint16_t addr, uint8_t val);
     bool verify_operations(nlohmann::json json);
     void analyse_operations(nlohmann::json json);
     bool conflict_check();
+    const std::vector<BusOperation> &operations_ref() const;
 };
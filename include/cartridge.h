@@ -1,23 +1,40 @@
-#include "mem.h"
+#pragma once
+
+#include "mapper.h"
+#include "romimage.h"
+#include "saveram.h"
 
 #include <string>
+#include <vector>
+#include <array>
+#include <memory>
+#include <chrono>
 
 #include <cstdint>
 
 class Cartridge
 {
 public:
-    using PRGROM = Mem<1<<14>;
-    using CHRROM = Mem<1<<13>;
-    using VRAM = Mem<1<<11>;
+    using VRAM = std::array<uint8_t, 1<<12>;
 private:
-    PRGROM prg_rom;
-    CHRROM chr_rom;
+    std::shared_ptr<const RomImage> rom; // Shared between cartridges of the same game
+    std::vector<uint8_t> chr_ram;
+    std::unique_ptr<SaveRam> prg_ram;
     VRAM vram;
+    std::unique_ptr<Mapper> mapper;
 public:
-    Cartridge(const std::string &rom_path);
+    Cartridge(const std::string &rom_path,
+        std::chrono::milliseconds save_flush_interval = SaveRam::DEFAULT_FLUSH_INTERVAL);
+
+    Mapper::PRGWindow *prg_ref();
+    Mapper::CHRWindow *chr_ref();
+    Mapper::NametableWindow *vram_ref();
+    const VRAM &vram_data() const;
+    SaveRam *prg_ram_ref();
 
-    PRGROM *prg_ref();
-    CHRROM *chr_ref();
-    VRAM *vram_ref();
-};
\ No newline at end of file
+    void save_state(StateWriter &writer) const;
+    void load_state(StateReader &reader);
+    Mapper *mapper_ref();
+    uint32_t rom_crc32() const;
+    uint32_t save_ram_crc32() const;
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <array>
+
+#include <cstddef>
+#include <cstdint>
+
+// CRC-32 (IEEE 802.3), slice-by-8. Pass a previous result to continue a checksum.
+uint32_t crc32(const uint8_t *data, std::size_t size, uint32_t crc = 0);
+
+class SHA1
+{
+public:
+    using Digest = std::array<uint8_t, 20>;
+private:
+    std::array<uint32_t, 5> state;
+    std::array<uint8_t, 64> block;
+    std::size_t block_len;
+    uint64_t total_len;
+public:
+    SHA1();
+    void update(const uint8_t *data, std::size_t size);
+    Digest finish();
+
+    static Digest hash(const uint8_t *data, std::size_t size);
+private:
+    void process_block(const uint8_t *chunk);
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "addressmappeddevice.h"
+#include "savestate.h"
+
+#include <array>
+
+#include <cstdint>
+
+enum ControllerButton : uint8_t
+{
+    BUTTON_A = 0x01,
+    BUTTON_B = 0x02,
+    BUTTON_SELECT = 0x04,
+    BUTTON_START = 0x08,
+    BUTTON_UP = 0x10,
+    BUTTON_DOWN = 0x20,
+    BUTTON_LEFT = 0x40,
+    BUTTON_RIGHT = 0x80
+};
+
+// Standard controllers on $4016/$4017
+class Controller: public AddressMappedDevice
+{
+private:
+    std::array<uint8_t, 2> buttons;
+    std::array<uint8_t, 2> shift;
+    bool strobe;
+public:
+    Controller();
+
+    void set_buttons(int port, uint8_t state);
+    uint8_t get_buttons(int port) const;
+
+    uint8_t get(uint16_t addr);
+    void set(uint16_t addr, uint8_t val);
+
+    void save_state(StateWriter &writer) const;
+    void load_state(StateReader &reader);
+};
@@ -6,6 +6,8 @@
 #include <vector>
 
 class Bus;
+class StateWriter;
+class StateReader;
 
 struct StatusRegister
 {
@@ -33,6 +35,16 @@ struct StatusRegister
     }
 };
 
+struct CPURegisters
+{
+    uint16_t pc;
+    uint8_t a;
+    uint8_t x;
+    uint8_t y;
+    uint8_t s;
+    uint8_t p;
+};
+
 class CPU
 {
 private:
@@ -60,12 +72,21 @@ private:
     
 public:
     CPU();
+    void reset();
     void load_json(nlohmann::json json);
     bool verify_state(nlohmann::json json);
     void analyse_state(nlohmann::json json);
+    CPURegisters get_registers() const;
+    void set_registers(const CPURegisters &regs);
     void clock_cycle();
     void attach_bus(Bus *new_bus);
     bool mid_instruction();
+    uint8_t get_opcode() const;
+    bool interrupt_pending() const;
+    uint16_t get_interrupt_vector() const;
+
+    void save_state(StateWriter &writer) const;
+    void load_state(StateReader &reader);
 
     void trigger_rst();
     void trigger_irq();
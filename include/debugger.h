@@ -0,0 +1,86 @@
+#pragma once
+
+#include "cpu.h"
+#include "heatmap.h"
+
+#include <array>
+#include <bitset>
+
+#include <cstddef>
+#include <cstdint>
+
+// Copy of the machine state shown by the debugger panels
+struct DebugSnapshot
+{
+    static constexpr uint16_t CODE_BEFORE_PC = 64;
+
+    uint64_t frame;
+    uint64_t cycles;
+    CPURegisters registers;
+    std::array<uint8_t, 1<<11> cpu_mem;
+    std::array<uint8_t, 1<<12> vram;
+    std::array<uint8_t, 256> oam;
+    std::array<uint8_t, 32> palette;
+    uint16_t code_start; // registers.pc - CODE_BEFORE_PC
+    std::array<uint8_t, 256> code;
+};
+
+// Shared between the debugger panels and the emulation loop. The panels only
+// read the snapshot published at the end of each frame, never live state, and
+// request breakpoints and pauses, which NES evaluates at instruction
+// boundaries. With no breakpoints and no pause requested NES takes its normal
+// frame loop, so the debugger costs nothing.
+class Debugger
+{
+private:
+    std::bitset<1<<16> breakpoints;
+    std::size_t breakpoint_count;
+    bool break_requested;
+    bool paused;
+    bool resuming; // Skip the breakpoint execution stopped at
+    bool visible;
+    DebugSnapshot snapshot;
+    const AccessHeatmap *cpu_heatmap;
+    const AccessHeatmap *ppu_heatmap;
+public:
+    Debugger();
+
+    void set_breakpoint(uint16_t addr, bool enabled);
+    bool has_breakpoint(uint16_t addr) const;
+    void clear_breakpoints();
+    void request_break();
+    void resume();
+    bool is_paused() const;
+
+    // Whether NES must check for breaks this frame; read once per frame
+    bool active() const
+    {
+        return breakpoint_count > 0 || break_requested;
+    }
+
+    // Called at each instruction boundary while active
+    bool should_break(uint16_t pc)
+    {
+        if (resuming)
+        {
+            resuming = false;
+            return false;
+        }
+        if (break_requested || breakpoints[pc])
+        {
+            break_requested = false;
+            paused = true;
+            return true;
+        }
+        return false;
+    }
+
+    void set_visible(bool visible);
+    bool is_visible() const;
+    DebugSnapshot *snapshot_ref();
+    const DebugSnapshot *snapshot_ref() const;
+
+    void set_heatmaps(const AccessHeatmap *cpu, const AccessHeatmap *ppu);
+    const AccessHeatmap *cpu_heatmap_ref() const;
+    const AccessHeatmap *ppu_heatmap_ref() const;
+};
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+
+#include <cstddef>
+#include <cstdint>
+
+// Page size used for the emulated memories, set with `make DIRTY_PAGE_SIZE=n`.
+// 0 disables tracking.
+#ifndef NES_DIRTY_PAGE_SIZE
+#define NES_DIRTY_PAGE_SIZE 0
+#endif
+constexpr unsigned int DIRTY_PAGE_SIZE = NES_DIRTY_PAGE_SIZE;
+
+// One bit per PAGE_SIZE bytes, set on write and cleared by the consumer.
+// Marking a write is a shift, an OR and a store.
+template<unsigned int PAGE_SIZE>
+class DirtyPages
+{
+    static_assert((PAGE_SIZE & (PAGE_SIZE - 1)) == 0, "PAGE_SIZE must be a power of two");
+public:
+    static constexpr bool ENABLED = true;
+private:
+    std::vector<uint64_t> bits;
+    std::size_t pages;
+public:
+    DirtyPages(std::size_t size = 0) :
+        bits{}, pages{0}
+    {
+        resize(size);
+    }
+
+    void resize(std::size_t size)
+    {
+        pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+        bits.assign((pages + 63) / 64, 0);
+        mark_all();
+    }
+
+    void mark(std::size_t offset)
+    {
+        std::size_t page = offset / PAGE_SIZE;
+        bits[page / 64] |= uint64_t(1) << (page % 64);
+    }
+
+    void mark_all()
+    {
+        for (std::size_t i = 0; i < bits.size(); ++i)
+        {
+            std::size_t remaining = pages - i * 64;
+            bits[i] = (remaining >= 64) ? ~uint64_t(0) : (uint64_t(1) << remaining) - 1;
+        }
+    }
+
+    void clear()
+    {
+        std::fill(bits.begin(), bits.end(), 0);
+    }
+
+    bool is_dirty(std::size_t page) const
+    {
+        return (bits[page / 64] >> (page % 64)) & 0x1;
+    }
+
+    bool any() const
+    {
+        for (uint64_t word : bits)
+        {
+            if (word) return true;
+        }
+        return false;
+    }
+
+    std::size_t page_size() const
+    {
+        return PAGE_SIZE;
+    }
+
+    std::size_t page_count() const
+    {
+        return pages;
+    }
+
+    // Calls fn(page) for every dirty page in ascending order
+    template<typename Fn>
+    void for_each(Fn fn) const
+    {
+        for (std::size_t i = 0; i < bits.size(); ++i)
+        {
+            uint64_t word = bits[i];
+            while (word)
+            {
+                fn(i * 64 + __builtin_ctzll(word));
+                word &= word - 1;
+            }
+        }
+    }
+};
+
+// Tracking disabled: the class is empty and nothing is marked. Every memory
+// is reported as one permanently dirty page, larger than any memory, so
+// consumers clamping pages to their memory's size stay correct.
+template<>
+class DirtyPages<0>
+{
+public:
+    static constexpr bool ENABLED = false;
+
+    DirtyPages(std::size_t size = 0)
+    {}
+
+    void resize(std::size_t size)
+    {}
+
+    void mark(std::size_t offset)
+    {}
+
+    void mark_all()
+    {}
+
+    void clear()
+    {}
+
+    bool is_dirty(std::size_t page) const
+    {
+        return true;
+    }
+
+    bool any() const
+    {
+        return true;
+    }
+
+    std::size_t page_size() const
+    {
+        return std::numeric_limits<std::size_t>::max();
+    }
+
+    std::size_t page_count() const
+    {
+        return 1;
+    }
+
+    template<typename Fn>
+    void for_each(Fn fn) const
+    {
+        fn(0);
+    }
+};
+
+// The bitmap type of the emulated memories
+using DirtyMap = DirtyPages<DIRTY_PAGE_SIZE>;
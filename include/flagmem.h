@@ -1,6 +1,7 @@
 #pragma once
 
 #include "addressmappeddevice.h"
+#include "savestate.h"
 
 #include "nlohmann/json.hpp"
 
@@ -71,6 +72,18 @@ public:
         memory[addr % SIZE] = val;
     }
 
+    void save_state(StateWriter &writer) const
+    {
+        writer.write_bytes(memory.data(), memory.size());
+        writer.write_bytes(flags.data(), flags.size() * sizeof(bool));
+    }
+
+    void load_state(StateReader &reader)
+    {
+        reader.read_bytes(memory.data(), memory.size());
+        reader.read_bytes(flags.data(), flags.size() * sizeof(bool));
+    }
+
     bool check(uint16_t addr)
     {
         bool active = flags[addr];
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "ppu.h"
+
+#include <cstdint>
+
+constexpr uint32_t FRAMEBUFFER_BACKGROUND = 0xFF000000;
+constexpr uint32_t FRAMEBUFFER_FOREGROUND = 0xFFFFFFFF;
+
+// Converts the PPU's column-major palette indices into row-major ARGB8888
+// pixels (RESOLUTION_X * RESOLUTION_Y of them), ready for a streaming
+// texture. Index 0 is background, anything else foreground.
+void convert_framebuffer(const PPU::Display &display, uint32_t *pixels);
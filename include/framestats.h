@@ -0,0 +1,53 @@
+#pragma once
+
+#include <array>
+
+#include <cstddef>
+#include <cstdint>
+
+// Where the time of a frame went, in milliseconds
+struct FrameTiming
+{
+    double cpu;
+    double ppu;
+    double present;
+    double idle;
+};
+
+// Per-frame timings recorded by NES::run for the performance overlay. A frame
+// costs a few clock reads to record. CPU and PPU are interleaved every cycle,
+// so emulation time is split between them by the ratio measured on an
+// occasional instrumented frame (see NES::run_split_frame).
+class FrameStats
+{
+public:
+    static constexpr std::size_t HISTORY = 240;
+    static constexpr unsigned int SPLIT_INTERVAL = 120;
+    static constexpr double NTSC_FPS = 60.0988;
+private:
+    std::array<float, HISTORY> frame_times;
+    std::size_t head;
+
+    // Exponential moving averages, so the overlay reads steadily
+    double frame_ms;
+    double cycles_per_frame;
+    double emulate_ms;
+    double present_ms;
+    double cpu_share;
+    bool cpu_share_valid; // Set by a split frame, cleared when one is pre-empted
+public:
+    FrameStats();
+
+    void record(double frame_ms, double emulate_ms, double present_ms, uint64_t cycles);
+    void set_cpu_share(double share);
+    void invalidate_cpu_share();
+    bool has_cpu_share() const;
+
+    double fps() const;
+    double speed() const;
+    double cycles_per_second() const;
+    FrameTiming timing() const;
+
+    const float *frame_times_ref() const;
+    std::size_t history_offset() const;
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "addressmappeddevice.h"
+
+#include <array>
+#include <vector>
+#include <string>
+
+#include <cstddef>
+#include <cstdint>
+
+enum HeatmapAccess
+{
+    HEAT_READ, // Includes instruction fetches
+    HEAT_WRITE,
+    HEAT_FETCH, // Opcode fetches at instruction starts
+    HEAT_ACCESS_COUNT
+};
+
+// Dump layout: the header, then `size` counters each for reads, writes and
+// fetches, in that order.
+struct HeatmapHeader
+{
+    static constexpr char MAGIC[8] = {'N', 'E', 'S', 'H', 'E', 'A', 'T', '\0'};
+    static constexpr uint32_t VERSION = 1;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t size;
+};
+static_assert(sizeof(HeatmapHeader) == 16, "HeatmapHeader is an on-disk record");
+
+// Access counters per bus address. decay() halves them all, so with periodic
+// decay the map shows recent activity rather than the whole run. Counters
+// stick at UINT32_MAX rather than wrapping on long undecayed runs.
+class AccessHeatmap
+{
+private:
+    std::size_t size;
+    std::array<std::vector<uint32_t>, HEAT_ACCESS_COUNT> counts;
+    bool suspended; // Accesses are ignored, e.g. in speculative frames
+public:
+    AccessHeatmap(std::size_t size);
+
+    void count(HeatmapAccess access, uint16_t addr)
+    {
+        uint32_t &counter = counts[access][addr % size];
+        counter += !suspended && counter != UINT32_MAX;
+    }
+
+    std::size_t get_size() const;
+    const uint32_t *counts_ref(HeatmapAccess access) const;
+    uint32_t max_count(HeatmapAccess access) const;
+    void decay();
+    void clear();
+    void set_suspended(bool suspended);
+    void save(const std::string &path) const;
+};
+
+// Stands in for a device on a bus while its heatmap is on, counting each
+// access by bus address and forwarding it
+class CountingDevice: public AddressMappedDevice
+{
+private:
+    AddressMappedDevice *device;
+    AccessHeatmap *heatmap;
+    uint16_t base;
+public:
+    CountingDevice(AddressMappedDevice *device, AccessHeatmap *heatmap, uint16_t base);
+
+    AddressMappedDevice *device_ref();
+    uint8_t get(uint16_t addr);
+    void set(uint16_t addr, uint8_t val);
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+enum MirroringType
+{
+    HORIZONTAL,
+    VERTICAL,
+    SINGLE_SCREEN_LOW,
+    SINGLE_SCREEN_HIGH,
+    FOUR_SCREEN
+};
+
+struct INESHeader
+{
+    static constexpr std::size_t SIZE = 16;
+    static constexpr std::size_t TRAINER_SIZE = 512;
+
+    int mapper;
+    int submapper;
+    std::size_t prg_rom_size;
+    std::size_t chr_rom_size;
+    std::size_t prg_ram_size;
+    std::size_t prg_nvram_size;
+    std::size_t chr_ram_size;
+    MirroringType mirroring;
+    bool battery;
+    bool trainer;
+    bool nes2;
+
+    std::size_t prg_offset() const
+    {
+        return SIZE + (trainer ? TRAINER_SIZE : 0);
+    }
+
+    std::size_t chr_offset() const
+    {
+        return prg_offset() + prg_rom_size;
+    }
+};
+
+INESHeader parse_ines_header(const uint8_t *data, std::size_t size);
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "addressmappeddevice.h"
+
+#include <array>
+#include <vector>
+
+#include <cstdint>
+
+// 64 KB memory for CPU tests. Writes are journaled so reset() zeroes only
+// the handful of addresses a case touched instead of the whole array.
+class JournalMem: public AddressMappedDevice
+{
+private:
+    std::array<uint8_t, 1<<16> memory;
+    std::vector<uint16_t> journal;
+public:
+    JournalMem() :
+        memory{}, journal{}
+    {
+        journal.reserve(64);
+    }
+
+    uint8_t get(uint16_t addr)
+    {
+        return memory[addr];
+    }
+
+    void set(uint16_t addr, uint8_t val)
+    {
+        memory[addr] = val;
+        journal.push_back(addr);
+    }
+
+    void reset()
+    {
+        for (uint16_t addr : journal)
+        {
+            memory[addr] = 0;
+        }
+        journal.clear();
+    }
+};
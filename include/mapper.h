@@ -0,0 +1,159 @@
+#pragma once
+
+#include "addressmappeddevice.h"
+#include "bankedmem.h"
+#include "ines.h"
+#include "savestate.h"
+
+#include <array>
+#include <memory>
+
+#include <cstddef>
+#include <cstdint>
+
+struct CartridgeMemory
+{
+    const uint8_t *prg_rom;
+    std::size_t prg_rom_size;
+    const uint8_t *chr_rom;
+    uint8_t *chr_ram; // Set instead of chr_rom on boards with CHR-RAM
+    std::size_t chr_size;
+    uint8_t *vram; // 4 KB, the upper half is only used for four-screen boards
+    MirroringType mirroring;
+};
+
+// Base for cartridge boards. The mapper owns the bank tables of the windows
+// mapped onto the CPU and PPU buses and receives writes to the PRG window.
+class Mapper: public AddressMappedDevice
+{
+public:
+    using PRGWindow = BankedMem<4, 1<<13>; // $8000-$FFFF
+    using CHRWindow = BankedMem<8, 1<<10, DIRTY_PAGE_SIZE>; // PPU $0000-$1FFF
+    using NametableWindow = BankedMem<4, 1<<10, DIRTY_PAGE_SIZE>; // PPU $2000-$2FFF
+protected:
+    CartridgeMemory mem;
+    PRGWindow prg;
+    CHRWindow chr;
+    NametableWindow nametables;
+public:
+    Mapper(const CartridgeMemory &mem);
+    virtual ~Mapper() = default;
+
+    static std::unique_ptr<Mapper> create(int id, const CartridgeMemory &mem);
+
+    PRGWindow *prg_ref();
+    CHRWindow *chr_ref();
+    NametableWindow *nametable_ref();
+    int prg_bank(uint16_t addr) const;
+
+    uint8_t get(uint16_t addr);
+    virtual void set(uint16_t addr, uint8_t val) = 0;
+    virtual void update_banks() = 0;
+
+    virtual void save_state(StateWriter &writer) const = 0;
+    virtual void load_state(StateReader &reader) = 0;
+
+    virtual void clock_scanline();
+    virtual bool irq_pending();
+protected:
+    void map_prg(unsigned int slot, unsigned int slots, int bank);
+    void map_chr(unsigned int slot, unsigned int slots, int bank);
+    void set_mirroring(MirroringType mirroring);
+};
+
+// Mapper 0: 16 or 32 KB PRG, 8 KB CHR, no banking
+class NROM: public Mapper
+{
+public:
+    NROM(const CartridgeMemory &mem);
+    void set(uint16_t addr, uint8_t val);
+    void update_banks();
+
+    void save_state(StateWriter &writer) const;
+    void load_state(StateReader &reader);
+};
+
+// Mapper 1: serial-loaded control, CHR and PRG registers
+class MMC1: public Mapper
+{
+private:
+    uint8_t shift;
+    uint8_t control;
+    uint8_t chr_bank0;
+    uint8_t chr_bank1;
+    uint8_t prg_bank;
+public:
+    MMC1(const CartridgeMemory &mem);
+    void set(uint16_t addr, uint8_t val);
+    void update_banks();
+
+    void save_state(StateWriter &writer) const;
+    void load_state(StateReader &reader);
+};
+
+// Mapper 2: switchable 16 KB at $8000, last bank fixed at $C000
+class UxROM: public Mapper
+{
+private:
+    uint8_t prg_bank;
+public:
+    UxROM(const CartridgeMemory &mem);
+    void set(uint16_t addr, uint8_t val);
+    void update_banks();
+
+    void save_state(StateWriter &writer) const;
+    void load_state(StateReader &reader);
+};
+
+// Mapper 3: switchable 8 KB CHR
+class CNROM: public Mapper
+{
+private:
+    uint8_t chr_bank;
+public:
+    CNROM(const CartridgeMemory &mem);
+    void set(uint16_t addr, uint8_t val);
+    void update_banks();
+
+    void save_state(StateWriter &writer) const;
+    void load_state(StateReader &reader);
+};
+
+// Mapper 4: 8 KB PRG and 1/2 KB CHR banking with a scanline IRQ counter
+class MMC3: public Mapper
+{
+private:
+    uint8_t bank_select;
+    std::array<uint8_t, 8> bank_regs;
+    uint8_t mirroring_reg;
+    uint8_t prg_ram_protect;
+    uint8_t irq_latch;
+    uint8_t irq_counter;
+    bool irq_reload;
+    bool irq_enabled;
+    bool irq_flag;
+public:
+    MMC3(const CartridgeMemory &mem);
+    void set(uint16_t addr, uint8_t val);
+    void update_banks();
+
+    void save_state(StateWriter &writer) const;
+    void load_state(StateReader &reader);
+
+    void clock_scanline();
+    bool irq_pending();
+};
+
+// Mapper 7: switchable 32 KB PRG with single-screen mirroring select
+class AxROM: public Mapper
+{
+private:
+    uint8_t bank;
+public:
+    AxROM(const CartridgeMemory &mem);
+    void set(uint16_t addr, uint8_t val);
+    void update_banks();
+
+    void save_state(StateWriter &writer) const;
+    void load_state(StateReader &reader);
+};
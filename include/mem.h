@@ -1,6 +1,8 @@
 #pragma once
 
 #include "addressmappeddevice.h"
+#include "savestate.h"
+#include "dirtypages.h"
 
 #include "nlohmann/json.hpp"
 
@@ -8,20 +10,22 @@
 #include <vector>
 #include <string>
 #include <iostream>
-#include <fstream>
 
 #include <cstdint>
 
-template<unsigned int SIZE>
-class Mem: public AddressMappedDevice
+// The dirty bitmap is a private base rather than a member, so with tracking
+// off the empty DirtyPages<0> takes no space
+template<unsigned int SIZE, unsigned int PAGE_SIZE = 0>
+class Mem: public AddressMappedDevice, private DirtyPages<PAGE_SIZE>
 {
 public:
     using MemoryArray = std::array<uint8_t, SIZE>;
+    using Dirty = DirtyPages<PAGE_SIZE>;
 private:
     MemoryArray memory;
 public:
     Mem() :
-        memory{}
+        Dirty(SIZE), memory{}
     {}
 
     void load_json(const nlohmann::json &json)
@@ -67,26 +71,27 @@ public:
     void set(uint16_t addr, uint8_t val)
     {
         memory[addr % SIZE] = val;
+        Dirty::mark(addr % SIZE);
     }
 
-    void load_binary_region(const std::string &filepath, std::streamoff offset, std::size_t length)
+    const uint8_t *data() const
     {
-        if (length > SIZE)
-        {
-            throw std::runtime_error("Length to read exceeds memory size.");
-        }
+        return memory.data();
+    }
 
-        std::ifstream file(filepath, std::ios::binary);
-        if (!file.is_open())
-        {
-            throw std::runtime_error("Failed to open binary file: " + filepath);
-        }
+    Dirty *dirty_ref()
+    {
+        return this;
+    }
 
-        file.seekg(offset);
-        file.read(reinterpret_cast<char*>(memory.data()), length);
-        if (file.gcount() != static_cast<std::streamsize>(length))
-        {
-            throw std::runtime_error("Failed to load full region into memory.");
-        }
+    void save_state(StateWriter &writer) const
+    {
+        writer.write_bytes(memory.data(), memory.size());
+    }
+
+    void load_state(StateReader &reader)
+    {
+        reader.read_bytes(memory.data(), memory.size());
+        Dirty::mark_all();
     }
 };
\ No newline at end of file
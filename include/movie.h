@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <array>
+
+#include <cstddef>
+#include <cstdint>
+
+// Per-frame controller input for both ports, in a compact native format
+// (.nesm). FCEUX .fm2 movies can be imported.
+class Movie
+{
+public:
+    using Input = std::array<uint8_t, 2>;
+
+    static constexpr char MAGIC[4] = {'N', 'E', 'S', 'M'};
+    static constexpr uint16_t VERSION = 1;
+private:
+    uint32_t rom_crc;
+    std::vector<Input> frames;
+public:
+    Movie();
+    Movie(const std::string &path);
+
+    void save(const std::string &path) const;
+
+    std::size_t frame_count() const;
+    const Input &frame(std::size_t i) const;
+    void append(const Input &input);
+    void truncate(std::size_t count);
+
+    uint32_t get_rom_crc() const;
+    void set_rom_crc(uint32_t crc);
+private:
+    void load_native(const std::string &path);
+    void load_fm2(const std::string &path);
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+class NES;
+class Movie;
+
+// Full save states taken every `interval` frames of a movie, so seeking to
+// any frame loads the keyframe at or before it and emulates at most
+// interval - 1 frames forward. The interval is chosen so the keyframes fit a
+// byte budget. Stored next to the movie as <movie>.idx.
+class MovieIndex
+{
+public:
+    static constexpr char MAGIC[8] = {'N', 'E', 'S', 'M', 'I', 'D', 'X', '\0'};
+    static constexpr uint16_t VERSION = 1;
+    static constexpr std::size_t DEFAULT_BUDGET = std::size_t(64) << 20;
+private:
+    uint32_t interval;
+    std::size_t state_size;
+    std::vector<uint8_t> keyframes; // keyframe_count() states of state_size bytes
+public:
+    MovieIndex();
+
+    static std::string path_for(const std::string &movie_path);
+    static uint32_t interval_for(std::size_t frames, std::size_t state_size, std::size_t budget);
+
+    void build(NES &nes, const Movie &movie, std::size_t budget = DEFAULT_BUDGET);
+    bool load(const std::string &path, const NES &nes, const Movie &movie);
+    void save(const std::string &path, const NES &nes, const Movie &movie) const;
+
+    void seek(NES &nes, uint64_t frame) const;
+
+    uint32_t get_interval() const;
+    std::size_t keyframe_count() const;
+};
@@ -1,21 +1,40 @@
 #pragma once
 
 #include "cartridge.h"
+#include "controller.h"
 #include "cpu.h"
 #include "bus.h"
 #include "mem.h"
 #include "ppu.h"
+#include "rewind.h"
+#include "movie.h"
+#include "framestats.h"
+#include "debugger.h"
+#include "profiler.h"
+#include "opcodestats.h"
+#include "perfcounters.h"
 
 #include <string>
 #include <array>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <ostream>
+
+#include <cstddef>
+#include <cstdint>
 
 class Window;
 
 class NES
 {
+public:
+    static constexpr uint32_t STATE_MAGIC = 0x53454E53; // "SNES" little-endian
+    static constexpr uint16_t STATE_VERSION = 3;
 private:
-    using CPUMem = Mem<1<<11>;
-    using PaletteMem = Mem<1<<8>;
+    using CPUMem = Mem<1<<11, DIRTY_PAGE_SIZE>;
+    using PaletteMem = Mem<1<<8, DIRTY_PAGE_SIZE>;
+    using IORegisters = Mem<0x20>; // Stands in for the APU until there is one
 
     Bus cpu_bus;
     Bus ppu_bus;
@@ -23,13 +42,95 @@ private:
     CPU cpu;
     CPUMem cpu_mem;
     Cartridge cartridge;
+    Controller controller;
+    IORegisters io_registers;
 
     PPU ppu;
     PaletteMem palette_mem;
 
     Window *window;
+    uint64_t cycles;
+
+    std::unique_ptr<Rewind> rewind;
+
+    unsigned int run_ahead;
+    std::vector<uint8_t> run_ahead_state;
+
+    uint64_t frame; // Frames stepped since reset or since a movie started
+    const Movie *playback;
+    Movie *recording;
+    std::ostream *hash_log;
+
+    FrameStats stats;
+    bool split_frame; // Time CPU and PPU separately on the next frame
+
+    Debugger debugger;
+    bool mid_frame; // Stopped at a breakpoint partway through a frame
+
+    std::unique_ptr<Profiler> profiler;
+    std::unique_ptr<OpcodeStats> opcode_stats;
+    std::unique_ptr<PerfLog> perf_log;
+
+    std::unique_ptr<AccessHeatmap> cpu_heatmap;
+    std::unique_ptr<AccessHeatmap> ppu_heatmap;
+    unsigned int heatmap_decay; // Frames between halving the counts, 0 for never
 public:
-    NES(Window *window, const std::string &rom_path);
+    NES(Window *window, const std::string &rom_path,
+        std::chrono::milliseconds save_flush_interval = SaveRam::DEFAULT_FLUSH_INTERVAL);
 
     void run();
+    void reset();
+    void run_frame();
+    void step_frame();
+    uint64_t get_frame() const;
+    uint64_t get_cycles() const;
+    uint8_t read_memory(uint16_t addr);
+    uint32_t frame_crc32() const;
+    Bus *cpu_bus_ref();
+    const FrameStats *stats_ref() const;
+    Debugger *debugger_ref();
+    uint8_t peek_memory(uint16_t addr);
+    void set_frame(uint64_t frame);
+    void fast_forward(uint64_t target_frame);
+    void set_input(int port, uint8_t buttons);
+    void set_run_ahead(unsigned int frames);
+
+    void play_movie(const Movie *movie);
+    void record_movie(Movie *movie);
+    bool movie_finished() const;
+    void set_hash_log(std::ostream *log);
+    uint32_t rom_crc32() const;
+    uint32_t save_ram_crc32() const;
+
+    void enable_rewind(std::size_t capacity, unsigned int keyframe_interval = 60);
+    bool rewind_frame();
+
+    void enable_profiler(unsigned int interval = Profiler::DEFAULT_INTERVAL);
+    const Profiler *profiler_ref() const;
+    void enable_opcode_stats();
+    const OpcodeStats *opcode_stats_ref() const;
+    bool set_perf_log(std::ostream *log);
+    void enable_heatmaps(unsigned int decay_interval);
+    const AccessHeatmap *cpu_heatmap_ref() const;
+    const AccessHeatmap *ppu_heatmap_ref() const;
+
+    DirtyMap *cpu_mem_dirty_ref();
+    DirtyMap *vram_dirty_ref();
+    DirtyMap *oam_dirty_ref();
+    DirtyMap *palette_dirty_ref();
+    DirtyMap *chr_ram_dirty_ref();
+    DirtyMap *prg_ram_dirty_ref();
+
+    std::size_t state_size() const;
+    std::size_t save_state(uint8_t *buffer, std::size_t capacity) const;
+    void load_state(const uint8_t *buffer, std::size_t size);
+private:
+    void run_ahead_frame();
+    void set_heatmaps_suspended(bool suspended);
+    void run_split_frame();
+    bool run_debug_frame();
+    void run_instrumented_frame();
+    void publish_snapshot();
+    void write_frame_hash();
+    void save_components(StateWriter &writer) const;
 };
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+
+#include <cstdint>
+
+enum AddressingMode
+{
+    IMPLIED,
+    ACCUMULATOR,
+    IMMEDIATE,
+    ZERO_PAGE,
+    ZERO_PAGE_X,
+    ZERO_PAGE_Y,
+    RELATIVE,
+    ABSOLUTE,
+    ABSOLUTE_X,
+    ABSOLUTE_Y,
+    INDIRECT,
+    INDEXED_INDIRECT, // (zp,X)
+    INDIRECT_INDEXED, // (zp),Y
+    ADDRESSING_MODE_COUNT
+};
+
+struct OpcodeInfo
+{
+    const char *mnemonic; // nullptr for unofficial opcodes
+    AddressingMode mode;
+    uint8_t cycles; // Without page-cross or taken-branch penalties
+};
+
+const OpcodeInfo &opcode_info(uint8_t opcode);
+const char *addressing_mode_name(AddressingMode mode);
+unsigned int instruction_length(AddressingMode mode);
+std::string disassemble(uint16_t addr, const uint8_t *bytes);
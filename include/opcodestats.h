@@ -0,0 +1,55 @@
+#pragma once
+
+#include "nlohmann/json.hpp"
+
+#include <array>
+#include <ostream>
+
+#include <cstdint>
+
+struct OpcodeCounters
+{
+    uint64_t executions;
+    uint64_t cycles;
+    uint64_t page_cross_cycles; // Beyond the base count, from indexing or branches
+    uint64_t branches_taken;
+    uint64_t branches_not_taken;
+    uint64_t unexpected; // Executions whose length no penalty explains
+};
+
+enum InterruptType
+{
+    INTERRUPT_RESET,
+    INTERRUPT_NMI,
+    INTERRUPT_IRQ,
+    INTERRUPT_TYPE_COUNT
+};
+
+// Execution and cycle counts per opcode, measured as the cycles between one
+// instruction start and the next and checked against the opcode table.
+// Interrupt entries are counted separately rather than as BRK.
+class OpcodeStats
+{
+private:
+    std::array<OpcodeCounters, 256> opcodes;
+    std::array<uint64_t, INTERRUPT_TYPE_COUNT> interrupts;
+    uint64_t interrupt_cycles;
+
+    bool open; // An instruction has started and not yet been ended
+    bool open_interrupt;
+    uint8_t open_opcode;
+    uint64_t open_cycle;
+public:
+    OpcodeStats();
+
+    void begin(uint8_t opcode, uint64_t cycle);
+    void begin_interrupt(uint16_t vector, uint64_t cycle);
+    void end(uint64_t cycle);
+    void abandon();
+
+    const OpcodeCounters &counters(uint8_t opcode) const;
+    uint64_t interrupt_count(InterruptType type) const;
+
+    nlohmann::json to_json() const;
+    void write_report(std::ostream &out) const;
+};
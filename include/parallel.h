@@ -0,0 +1,149 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <functional>
+#include <memory>
+
+#include <cstddef>
+
+// Runs fn(i) for every i in [0, count) across a pool of threads. Items are
+// handed out one at a time, so uneven item costs still balance out.
+template<typename Fn>
+void parallel_for(std::size_t count, Fn fn, unsigned int threads = 0)
+{
+    if (threads == 0)
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = static_cast<unsigned int>(std::min<std::size_t>(threads, std::max<std::size_t>(count, 1)));
+
+    std::atomic<std::size_t> next{0};
+    auto worker = [&]()
+    {
+        for (std::size_t i = next++; i < count; i = next++)
+        {
+            fn(i);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned int t = 1; t < threads; ++t)
+    {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto &thread : pool)
+    {
+        thread.join();
+    }
+}
+
+// Pool with one task deque per worker. A worker runs its own newest task
+// first and, when it has none, steals the oldest task of another worker, so
+// a task that splits itself keeps its pieces local until others run dry.
+// Tasks receive the index of the worker running them, for per-worker state.
+class WorkStealingPool
+{
+public:
+    using Task = std::function<void(unsigned int worker)>;
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::atomic<std::size_t> pending; // Queued or running
+public:
+    WorkStealingPool(unsigned int threads = 0) :
+        queues{}, pending{0}
+    {
+        if (threads == 0)
+        {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        for (unsigned int i = 0; i < threads; ++i)
+        {
+            queues.push_back(std::make_unique<Queue>());
+        }
+    }
+
+    unsigned int size() const
+    {
+        return static_cast<unsigned int>(queues.size());
+    }
+
+    // Safe to call from inside a running task
+    void push(unsigned int worker, Task task)
+    {
+        ++pending;
+        Queue &queue = *queues[worker % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+
+    // Runs until every task, including ones pushed by tasks, has finished
+    void run()
+    {
+        std::vector<std::thread> pool;
+        for (unsigned int t = 1; t < size(); ++t)
+        {
+            pool.emplace_back(&WorkStealingPool::work, this, t);
+        }
+        work(0);
+        for (auto &thread : pool)
+        {
+            thread.join();
+        }
+    }
+private:
+    bool take(unsigned int worker, Task &task)
+    {
+        {
+            Queue &own = *queues[worker];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty())
+            {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                return true;
+            }
+        }
+        for (unsigned int i = 1; i < size(); ++i)
+        {
+            Queue &victim = *queues[(worker + i) % size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty())
+            {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void work(unsigned int worker)
+    {
+        Task task;
+        while (pending > 0)
+        {
+            if (take(worker, task))
+            {
+                task(worker);
+                task = nullptr;
+                --pending;
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <ostream>
+
+#include <cstddef>
+#include <cstdint>
+
+// Hardware counters opened with Linux perf_event_open as one group, so they
+// are scheduled onto the PMU together and read with a single syscall.
+// Counters that cannot be opened (no permission, no PMU under a VM) are left
+// out; if none open the group is unavailable and reads return zeros. When the
+// PMU is shared the group only counts part of the time, which the enabled and
+// running times of each reading show.
+class PerfCounters
+{
+public:
+    enum Counter
+    {
+        CYCLES,
+        INSTRUCTIONS,
+        BRANCH_MISSES,
+        L1D_MISSES,
+        LLC_MISSES,
+        COUNTER_COUNT
+    };
+    using Values = std::array<uint64_t, COUNTER_COUNT>;
+
+    struct Reading
+    {
+        Values values;
+        uint64_t time_enabled; // ns
+        uint64_t time_running; // ns on the PMU, less than time_enabled when multiplexed
+    };
+private:
+    std::array<int, COUNTER_COUNT> fds;
+    std::array<int, COUNTER_COUNT> slots; // Position in a group read, -1 if not open
+    int leader;
+    std::size_t opened;
+public:
+    PerfCounters();
+    ~PerfCounters();
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    bool available() const;
+    bool has(Counter counter) const;
+    Reading read() const;
+
+    static const char *name(Counter counter);
+};
+
+// Writes one CSV row per frame phase with the counter deltas, IPC and misses
+// per thousand instructions. Columns of counters that are not available are empty.
+// Deltas of a phase the group only partly counted are scaled up to the whole
+// phase, and `running` gives the counted fraction; a phase it never counted
+// has no values.
+class PerfLog
+{
+private:
+    PerfCounters counters;
+    std::ostream &out;
+    PerfCounters::Reading phase_start;
+public:
+    PerfLog(std::ostream &out);
+
+    bool available() const;
+    void start();
+    void end(uint64_t frame, const char *phase);
+};
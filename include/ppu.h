@@ -6,9 +6,13 @@
 #include <cstdint>
 
 class Bus;
+class StateWriter;
+class StateReader;
 
 constexpr int RESOLUTION_X = 256;
 constexpr int RESOLUTION_Y = 240;
+constexpr int DOTS_PER_LINE = 341;
+constexpr int LINES_PER_FRAME = 262;
 
 
 class PPU
@@ -16,7 +20,7 @@ class PPU
 public:
     using Display = std::array<std::array<uint8_t, RESOLUTION_Y>, RESOLUTION_X>;
     using Registers = FlagMem<8>;
-    using OAM = Mem<256>;
+    using OAM = Mem<256, DIRTY_PAGE_SIZE>;
 private:
 
     Bus *bus;
@@ -29,6 +33,9 @@ private:
 
     uint8_t fine_x;
     uint16_t line;
+    uint16_t dot;
+    bool frame_done;
+    bool rendering; // Off for frames that are emulated but never shown
 
     uint8_t nt_id;
 
@@ -44,9 +51,16 @@ private:
 public:
     PPU();
     Registers *reg_ref();
+    const OAM *oam_ref() const;
+    OAM::Dirty *oam_dirty_ref();
 
     void attach_bus(Bus *new_bus);
     void clock_cycle();
     Display get_display();
+    const Display &display_ref() const;
+    void set_rendering(bool enabled);
     bool frame_complete();
+
+    void save_state(StateWriter &writer) const;
+    void load_state(StateReader &reader);
 };
\ No newline at end of file
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <ostream>
+
+#include <cstddef>
+#include <cstdint>
+
+class Mapper;
+
+// Sampling profiler for guest code. NES reports every instruction start and
+// clocks the profiler once per CPU cycle; every `interval` cycles the PC of
+// the current instruction is sampled together with the call stack, which is
+// rebuilt from JSR/RTS and interrupt entry/RTI. Locations carry the 8 KB PRG
+// bank so banked code at the same address is kept apart.
+class Profiler
+{
+public:
+    static constexpr unsigned int DEFAULT_INTERVAL = 1000;
+    static constexpr std::size_t MAX_DEPTH = 64;
+private:
+    const Mapper *mapper;
+    unsigned int interval;
+    unsigned int countdown;
+
+    std::vector<uint32_t> stack; // Function entry locations, outermost first
+    std::size_t overflow; // Calls not pushed because the stack was full
+    bool call_pending; // The next instruction is a function entry
+
+    uint64_t samples;
+    std::unordered_map<uint32_t, uint64_t> pc_samples;
+    std::map<std::vector<uint32_t>, uint64_t> stack_samples;
+public:
+    Profiler(const Mapper *mapper, unsigned int interval = DEFAULT_INTERVAL);
+
+    void instruction(uint16_t pc, uint8_t opcode)
+    {
+        if (call_pending) enter(pc);
+        switch (opcode)
+        {
+        case 0x00: // BRK, also seen for IRQ and NMI entry
+        case 0x20: // JSR
+            call_pending = true;
+            break;
+        case 0x40: // RTI
+        case 0x60: // RTS
+            leave();
+            break;
+        }
+    }
+
+    void clock(uint16_t pc)
+    {
+        if (--countdown == 0)
+        {
+            countdown = interval;
+            sample(pc);
+        }
+    }
+
+    uint64_t sample_count() const;
+    void write_flat(std::ostream &out) const;
+    void write_folded(std::ostream &out) const;
+    void save(const std::string &prefix) const;
+private:
+    uint32_t locate(uint16_t addr) const;
+    void enter(uint16_t pc);
+    void leave();
+    void sample(uint16_t pc);
+};
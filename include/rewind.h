@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+
+#include <cstddef>
+#include <cstdint>
+
+class NES;
+
+// Fixed-size ring of per-frame save states. Every keyframe_interval frames a
+// full state is stored; the frames in between are stored as the XOR against
+// that keyframe, and both are zero-run-length encoded. Restoring any frame
+// therefore decodes at most two records.
+class Rewind
+{
+private:
+    struct Snapshot
+    {
+        std::size_t offset;
+        std::size_t size;
+        std::size_t keyframe_offset;
+        std::size_t keyframe_size;
+        bool keyframe;
+    };
+
+    std::vector<uint8_t> ring;
+    std::size_t head;
+    std::deque<Snapshot> snapshots;
+
+    std::vector<uint8_t> state;
+    std::vector<uint8_t> keyframe;
+    std::vector<uint8_t> encoded;
+
+    unsigned int keyframe_interval;
+    unsigned int since_keyframe;
+    Snapshot current_keyframe;
+public:
+    Rewind(std::size_t state_size, std::size_t capacity, unsigned int keyframe_interval);
+
+    void capture(const NES &nes);
+    bool restore_previous(NES &nes);
+
+    std::size_t frame_count() const;
+    std::size_t bytes_used() const;
+private:
+    void store(const Snapshot &header, const std::vector<uint8_t> &data);
+    bool overwrites_keyframe(std::size_t size) const;
+    void evict(std::size_t start, std::size_t end);
+    void decode(const Snapshot &snapshot, std::vector<uint8_t> &out) const;
+};
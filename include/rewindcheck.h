@@ -0,0 +1,9 @@
+#pragma once
+
+#include <string>
+
+// Runs a ROM headlessly with rewind on, keeping a full save state for every
+// frame, then rewinds and checks that each restore yields the state and frame
+// number of the frame before. Half way back it emulates forward again to check
+// the ring keeps working after a rewind. Returns true if every step matched.
+bool check_rewind(const std::string &rom_path, unsigned int frames);
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "ines.h"
+
+#include <string>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+// Read-only view of an iNES file. The file is mapped with mmap so PRG/CHR
+// are used in place and shared through the page cache; if mapping fails the
+// file is read into a private buffer instead.
+class RomImage
+{
+private:
+    const uint8_t *data;
+    std::size_t size;
+    bool mapped;
+    std::vector<uint8_t> buffer;
+    INESHeader header;
+public:
+    RomImage(const std::string &path);
+    ~RomImage();
+
+    RomImage(const RomImage &) = delete;
+    RomImage &operator=(const RomImage &) = delete;
+
+    const INESHeader &get_header() const;
+    const uint8_t *prg_data() const;
+    const uint8_t *chr_data() const;
+    bool is_mapped() const;
+    uint32_t content_crc32() const;
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include <cstddef>
+#include <cstdint>
+
+// Fixed-size index record. Records are stored sorted by CRC32 so lookups are
+// a binary search over the mapped file.
+struct RomIndexEntry
+{
+    enum Flags : uint8_t
+    {
+        BATTERY = 0x01,
+        TRAINER = 0x02,
+        NES2 = 0x04
+    };
+
+    uint32_t crc32; // Of PRG + CHR
+    uint8_t sha1[20]; // Of PRG + CHR
+    uint32_t path_offset; // Into the string table
+    uint32_t path_length;
+    uint64_t file_size;
+    int64_t mtime_ns;
+    uint32_t prg_rom_size;
+    uint32_t chr_rom_size;
+    uint32_t prg_ram_size; // Volatile + battery-backed
+    uint16_t mapper;
+    uint8_t submapper;
+    uint8_t flags; // Flags in the low bits, MirroringType in bits 4-6
+
+    uint8_t mirroring() const
+    {
+        return (flags >> 4) & 0x7;
+    }
+};
+static_assert(sizeof(RomIndexEntry) == 64, "RomIndexEntry is an on-disk record");
+
+struct RomIndexHeader
+{
+    static constexpr char MAGIC[8] = {'N', 'E', 'S', 'R', 'O', 'M', 'I', 'X'};
+    static constexpr uint32_t VERSION = 1;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_count;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+};
+static_assert(sizeof(RomIndexHeader) == 32, "RomIndexHeader is an on-disk record");
+
+// Read-only, memory-mapped view of an index file
+class RomIndex
+{
+private:
+    const uint8_t *data;
+    std::size_t size;
+    const RomIndexEntry *entries;
+    std::size_t count;
+    const char *strings;
+    std::size_t strings_size;
+public:
+    RomIndex(const std::string &path);
+    ~RomIndex();
+
+    RomIndex(const RomIndex &) = delete;
+    RomIndex &operator=(const RomIndex &) = delete;
+
+    std::size_t entry_count() const;
+    const RomIndexEntry &entry(std::size_t i) const;
+    std::string_view path(const RomIndexEntry &entry) const;
+    const RomIndexEntry *find_crc32(uint32_t crc) const;
+};
+
+struct RomScanStats
+{
+    std::size_t hashed;
+    std::size_t reused; // Unchanged since the previous index
+    std::size_t failed;
+};
+
+// Scans root recursively for .nes files and writes an index to index_path.
+// Files whose size and mtime match the existing index are not re-read.
+RomScanStats index_rom_library(const std::string &root, const std::string &index_path, unsigned int threads = 0);
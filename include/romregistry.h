@@ -0,0 +1,50 @@
+#pragma once
+
+#include "romimage.h"
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include <cstddef>
+#include <cstdint>
+
+// Process-wide table of loaded ROM images keyed by a hash of their contents.
+// Cartridges holding the same game share one read-only image; it is released
+// when the last holder goes away. Paths seen before are matched on their file
+// identity, so reopening an unchanged file skips mapping and hashing it.
+class RomRegistry
+{
+private:
+    struct FileIdentity
+    {
+        uint64_t dev;
+        uint64_t ino;
+        int64_t mtime_sec;
+        int64_t mtime_nsec;
+        int64_t size;
+
+        bool operator==(const FileIdentity &other) const;
+    };
+
+    struct FileEntry
+    {
+        FileIdentity identity;
+        std::weak_ptr<const RomImage> image;
+    };
+
+    std::mutex mutex;
+    std::unordered_multimap<std::size_t, std::weak_ptr<const RomImage>> images;
+    std::unordered_map<std::string, FileEntry> files;
+public:
+    static RomRegistry &instance();
+
+    std::shared_ptr<const RomImage> acquire(const std::string &path);
+    std::size_t loaded_count();
+private:
+    std::shared_ptr<const RomImage> find_or_insert(const std::shared_ptr<const RomImage> &image);
+    void prune();
+    static std::size_t content_hash(const RomImage &image);
+    static bool same_content(const RomImage &a, const RomImage &b);
+};
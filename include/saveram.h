@@ -0,0 +1,66 @@
+#pragma once
+
+#include "addressmappeddevice.h"
+#include "savestate.h"
+#include "dirtypages.h"
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <cstddef>
+#include <cstdint>
+
+// Cartridge PRG-RAM at $6000-$7FFF. The RAM the guest runs on, and that save
+// states restore, is a private buffer. Battery-backed RAM also maps the save
+// file as a persistent copy: guest writes are copied into it and mark it
+// dirty, and a background thread msyncs it, so the emulation thread never
+// performs file I/O. Loading a state never touches the file; the next guest
+// write publishes the whole RAM so the file stays consistent. The page
+// bitmap is a private base, so it takes no space with tracking off.
+class SaveRam: public AddressMappedDevice, private DirtyPages<DIRTY_PAGE_SIZE>
+{
+public:
+    static constexpr std::chrono::milliseconds DEFAULT_FLUSH_INTERVAL{1000};
+    using Dirty = DirtyPages<DIRTY_PAGE_SIZE>;
+private:
+    std::vector<uint8_t> memory;
+    std::size_t size;
+    std::size_t mask;
+    uint8_t *persistent; // The mapped save file, nullptr without a battery
+    bool diverged; // memory differs from persistent since a state load
+    bool speculative; // Writes are from frames that will be rolled back
+    std::atomic<bool> dirty; // persistent since the last flush
+
+    std::chrono::milliseconds flush_interval;
+    std::thread flusher;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping;
+public:
+    SaveRam(std::size_t size);
+    SaveRam(std::size_t size, const std::string &save_path, std::chrono::milliseconds flush_interval);
+    ~SaveRam();
+
+    SaveRam(const SaveRam &) = delete;
+    SaveRam &operator=(const SaveRam &) = delete;
+
+    uint8_t get(uint16_t addr);
+    void set(uint16_t addr, uint8_t val);
+
+    void save_state(StateWriter &writer) const;
+    void load_state(StateReader &reader);
+
+    void set_speculative(bool speculative);
+    void flush();
+    bool is_persistent() const;
+    Dirty *dirty_ref();
+    uint32_t content_crc32() const;
+private:
+    void publish(std::size_t offset, uint8_t val);
+    void flush_loop();
+};
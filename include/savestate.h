@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdexcept>
+#include <type_traits>
+#include <cstring>
+
+#include <cstddef>
+#include <cstdint>
+
+// Sequential writer over a caller-provided buffer. Constructed with a null
+// buffer it only counts bytes, which is how state sizes are measured.
+class StateWriter
+{
+private:
+    uint8_t *buffer;
+    std::size_t capacity;
+    std::size_t offset;
+public:
+    StateWriter(uint8_t *buffer, std::size_t capacity) :
+        buffer{buffer}, capacity{capacity}, offset{0}
+    {}
+
+    template<typename T>
+    void write(const T &value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "State fields must be trivially copyable");
+        write_bytes(&value, sizeof(T));
+    }
+
+    void write_bytes(const void *data, std::size_t size)
+    {
+        if (buffer)
+        {
+            if (offset + size > capacity)
+            {
+                throw std::runtime_error("Save state buffer too small.");
+            }
+            std::memcpy(buffer + offset, data, size);
+        }
+        offset += size;
+    }
+
+    std::size_t size() const
+    {
+        return offset;
+    }
+};
+
+class StateReader
+{
+private:
+    const uint8_t *buffer;
+    std::size_t capacity;
+    std::size_t offset;
+public:
+    StateReader(const uint8_t *buffer, std::size_t capacity) :
+        buffer{buffer}, capacity{capacity}, offset{0}
+    {}
+
+    template<typename T>
+    void read(T &value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "State fields must be trivially copyable");
+        read_bytes(&value, sizeof(T));
+    }
+
+    void read_bytes(void *data, std::size_t size)
+    {
+        if (offset + size > capacity)
+        {
+            throw std::runtime_error("Save state is truncated.");
+        }
+        std::memcpy(data, buffer + offset, size);
+        offset += size;
+    }
+
+    std::size_t size() const
+    {
+        return offset;
+    }
+};
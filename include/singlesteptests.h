@@ -1,3 +1,4 @@
 #include <string>
 
-void run_tests(const std::string &test_dir);
\ No newline at end of file
+// threads = 0 uses every core. An empty cache_dir runs directly from the JSON.
+void run_tests(const std::string &test_dir, unsigned int threads = 0, const std::string &cache_dir = "");
\ No newline at end of file
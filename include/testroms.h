@@ -0,0 +1,9 @@
+#pragma once
+
+#include <string>
+
+// Runs every ROM listed in a manifest headlessly and prints a summary.
+// Each manifest line is `<rom> <cycle budget> [frame crc32]`, with the ROM
+// path relative to the manifest and `#` starting a comment. Returns true if
+// every ROM passed.
+bool run_test_roms(const std::string &manifest_path, unsigned int threads = 0);
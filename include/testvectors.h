@@ -0,0 +1,78 @@
+#pragma once
+
+#include "cpu.h"
+
+#include <string>
+
+#include <cstddef>
+#include <cstdint>
+
+// Compiled form of one SingleStepTests opcode file: fixed-size case records
+// followed by the RAM entries and bus cycles they index into. The file is
+// mapped and used in place.
+struct TestVectorHeader
+{
+    static constexpr char MAGIC[8] = {'N', 'E', 'S', 'S', 'S', 'T', 'V', '\0'};
+    static constexpr uint32_t VERSION = 1;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t case_count;
+    uint32_t ram_count;
+    uint32_t cycle_count;
+};
+static_assert(sizeof(TestVectorHeader) == 24, "TestVectorHeader is an on-disk record");
+
+struct TestRamEntry
+{
+    uint16_t addr;
+    uint8_t val;
+    uint8_t reserved;
+};
+
+struct TestCycle
+{
+    uint16_t addr;
+    uint8_t val;
+    uint8_t write; // 0 for a read
+};
+
+struct TestCaseRecord
+{
+    CPURegisters initial;
+    CPURegisters final;
+    uint32_t initial_ram; // First entry, into the RAM entry array
+    uint32_t final_ram;
+    uint32_t cycles; // First cycle, into the cycle array
+    uint16_t initial_ram_count;
+    uint16_t final_ram_count;
+    uint16_t cycle_count;
+    uint16_t reserved;
+};
+static_assert(sizeof(TestCaseRecord) == 36, "TestCaseRecord is an on-disk record");
+
+// Converts json_path to bin_path unless bin_path is already newer.
+// Returns true if the file was (re)built.
+bool compile_test_vectors(const std::string &json_path, const std::string &bin_path);
+
+class TestVectorFile
+{
+private:
+    const uint8_t *data;
+    std::size_t size;
+    const TestCaseRecord *records;
+    const TestRamEntry *ram;
+    const TestCycle *cycles;
+    std::size_t count;
+public:
+    TestVectorFile(const std::string &path);
+    ~TestVectorFile();
+
+    TestVectorFile(const TestVectorFile &) = delete;
+    TestVectorFile &operator=(const TestVectorFile &) = delete;
+
+    std::size_t case_count() const;
+    const TestCaseRecord &test_case(std::size_t i) const;
+    const TestRamEntry *ram_entries(uint32_t first) const;
+    const TestCycle *cycle_entries(uint32_t first) const;
+};
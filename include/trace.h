@@ -0,0 +1,91 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+
+#include <cstddef>
+#include <cstdint>
+
+// Scoped spans for Chrome's trace viewer (chrome://tracing, Perfetto). Spans
+// are only recorded in builds made with TRACE=1, which defines NES_TRACE;
+// otherwise TRACE_SCOPE and TRACE_THREAD_NAME expand to nothing.
+#ifdef NES_TRACE
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define TRACE_THREAD_NAME(name) Tracer::instance().name_thread(name)
+#else
+#define TRACE_SCOPE(name)
+#define TRACE_THREAD_NAME(name)
+#endif
+
+struct TraceEvent
+{
+    const char *name; // String literal
+    uint64_t start_ns;
+    uint64_t duration_ns;
+};
+
+// Events of one thread. Only that thread appends, publishing each event with
+// a release store of the count, so the writer can read any buffer without
+// locking. Events past CAPACITY are dropped rather than wrapping over ones
+// that may be being read.
+class TraceBuffer
+{
+public:
+    static constexpr std::size_t CAPACITY = 1<<18;
+private:
+    std::unique_ptr<TraceEvent[]> events;
+    std::atomic<std::size_t> count;
+    std::atomic<uint64_t> dropped;
+    uint32_t thread_id;
+    std::atomic<const char *> thread_name;
+public:
+    TraceBuffer(uint32_t thread_id);
+
+    void record(const char *name, uint64_t start_ns, uint64_t duration_ns)
+    {
+        std::size_t n = count.load(std::memory_order_relaxed);
+        if (n == CAPACITY)
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        events[n] = TraceEvent{name, start_ns, duration_ns};
+        count.store(n + 1, std::memory_order_release);
+    }
+
+    friend class Tracer;
+};
+
+// Process-wide list of thread buffers. A thread's buffer is created on its
+// first span and outlives the thread, so pool workers' spans survive them.
+class Tracer
+{
+private:
+    std::mutex mutex; // Guards buffers and output_path, never taken per span
+    std::vector<std::unique_ptr<TraceBuffer>> buffers;
+    std::string output_path;
+public:
+    static Tracer &instance();
+
+    TraceBuffer &thread_buffer();
+    void name_thread(const char *name);
+
+    void set_output(const std::string &path);
+    bool write();
+    bool write(const std::string &path);
+};
+
+class TraceScope
+{
+private:
+    const char *name;
+    uint64_t start_ns;
+public:
+    TraceScope(const char *name);
+    ~TraceScope();
+};
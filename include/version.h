@@ -0,0 +1,9 @@
+#pragma once
+
+// Identifies the emulation core that produced persisted snapshots. The
+// makefile sets it to a sha1 of src/*.cpp and include/*.h, so any rebuild
+// from changed sources invalidates them; bump STATE_VERSION in nes.h for
+// format changes.
+#ifndef NES_CORE_VERSION
+#define NES_CORE_VERSION "unversioned"
+#endif
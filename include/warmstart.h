@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+
+#include <cstdint>
+
+class NES;
+
+// Cache of each game's state after its first boot_frames frames, so runs
+// can skip the boot, RAM-clear and PPU warm-up sequence. Snapshots are keyed
+// by ROM CRC, boot length and battery RAM contents, and are discarded when
+// the core version or state format differs from the one that wrote them.
+class WarmStart
+{
+public:
+    static constexpr char MAGIC[8] = {'N', 'E', 'S', 'W', 'A', 'R', 'M', '\0'};
+    static constexpr uint16_t VERSION = 1;
+private:
+    std::string cache_dir;
+    unsigned int boot_frames;
+public:
+    WarmStart(const std::string &cache_dir, unsigned int boot_frames);
+
+    void start(NES &nes) const;
+    bool restore(NES &nes) const;
+    void capture(NES &nes) const;
+
+    std::string path_for(const NES &nes) const;
+};
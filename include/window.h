@@ -1,19 +1,40 @@
 #pragma once
 
 #include "ppu.h"
+#include "framestats.h"
+#include "debugger.h"
 
 #include <SDL2/SDL.h>
 
+#include <vector>
+
+#include <cstdint>
+
 class Window
 {
 private:
     SDL_Window *window;
     SDL_Renderer *renderer;
+    SDL_Texture *texture;
+    std::vector<uint32_t> pixels;
     int width;
     int height;
+    bool show_stats; // Toggled with F1
+    bool show_debugger; // Toggled with F2
+    char breakpoint_input[8];
+    bool show_heatmap; // Toggled with F4
+    bool rewinding; // Backspace held
+    SDL_Texture *cpu_heat_texture;
+    SDL_Texture *ppu_heat_texture;
+    std::vector<uint32_t> heat_pixels;
 public:
     Window(int width, int height);
-    void draw(const PPU::Display &display);
+    void draw(const PPU::Display &display, const FrameStats &stats, Debugger &debugger);
+    bool poll_input(uint8_t &buttons);
+    bool rewind_held() const;
+    bool stats_visible() const;
 private:
-    void draw_grid(const PPU::Display &display);
+    void draw_stats(const FrameStats &stats);
+    void draw_debugger(Debugger &debugger);
+    void draw_heatmap(const char *title, const AccessHeatmap &heatmap, SDL_Texture *&texture, int columns);
 };
\ No newline at end of file
@@ -6,24 +6,60 @@
 #include <iomanip>
 
 Bus::Bus() :
-    operations{}, conflict_log{}
+    operations{}, conflict_log{}, logging{true}
 {}
 
+// Clears the logs for the next test case, keeping mappings and capacity
+void Bus::reset()
+{
+    operations.clear();
+    conflict_log.clear();
+}
+
+// Operation and conflict logs are only needed to verify tests; emulation
+// turns them off so they do not grow without bound.
+void Bus::set_logging(bool enabled)
+{
+    logging = enabled;
+}
+
 void Bus::map_device(uint16_t start, uint16_t end, AddressMappedDevice *device)
 {
     mappings.emplace_back(Mapping{start, end, device});
 }
 
+// Routes every mapping through a CountingDevice feeding heatmap, or with
+// nullptr maps the original devices back. get and set are untouched, so
+// there is no cost while no heatmap is set. Map all devices first.
+void Bus::set_heatmap(AccessHeatmap *heatmap)
+{
+    if (!counting_devices.empty())
+    {
+        for (std::size_t i = 0; i < mappings.size(); ++i)
+        {
+            mappings[i].device = counting_devices[i]->device_ref();
+        }
+        counting_devices.clear();
+    }
+    if (!heatmap) return;
+
+    for (auto &m : mappings)
+    {
+        counting_devices.push_back(std::make_unique<CountingDevice>(m.device, heatmap, m.start));
+        m.device = counting_devices.back().get();
+    }
+}
+
 uint8_t Bus::get(uint16_t addr)
 {
-    conflict_log.back()++;
+    if (logging) conflict_log.back()++;
 
     for (const auto &m : mappings)
     {
         if (addr >= m.start && addr <= m.end)
         {
             uint8_t val = m.device->get(addr - m.start);
-            operations.emplace_back(BusOperation{addr, val, BusOperationType::READ});
+            if (logging) operations.emplace_back(BusOperation{addr, val, BusOperationType::READ});
             return val;
         }
     }
@@ -32,19 +68,19 @@ uint8_t Bus::get(uint16_t addr)
 
 void Bus::start_cycle()
 {
-    conflict_log.push_back(0);
+    if (logging) conflict_log.push_back(0);
 }
 
 void Bus::set(uint16_t addr, uint8_t val)
 {
-    conflict_log.back()++;
+    if (logging) conflict_log.back()++;
 
     for (const auto &m : mappings)
     {
         if (addr >= m.start && addr <= m.end)
         {
             m.device->set(addr - m.start, val);
-            operations.emplace_back(BusOperation{addr, val, BusOperationType::WRITE});
+            if (logging) operations.emplace_back(BusOperation{addr, val, BusOperationType::WRITE});
             return;
         }
     }
@@ -53,6 +89,10 @@ void Bus::set(uint16_t addr, uint8_t val)
 
 bool Bus::verify_operations(nlohmann::json json)
 {
+    // A missing or extra cycle fails like the compiled-vector path, and keeps
+    // json[i] from reading past the expected list
+    if (operations.size() != json.size()) return false;
+
     for (size_t i = 0; i < operations.size(); ++i)
     {
         if (operations[i].addr != json[i][0] ||
@@ -131,4 +171,9 @@ bool Bus::conflict_check()
     }
 
     return true;
+}
+
+const std::vector<BusOperation> &Bus::operations_ref() const
+{
+    return operations;
 }
\ No newline at end of file
@@ -1,46 +1,100 @@
 #include "cartridge.h"
+#include "romregistry.h"
 
-#include <stdexcept>
-#include <fstream>
 #include <iostream>
+#include <filesystem>
+#include <algorithm>
 
-Cartridge::Cartridge(const std::string &rom_path) :
-    vram{}
+Cartridge::Cartridge(const std::string &rom_path, std::chrono::milliseconds save_flush_interval) :
+    rom(RomRegistry::instance().acquire(rom_path)), chr_ram{}, vram{}
 {
-    std::ifstream file(rom_path, std::ios::binary);
-    if (!file.is_open())
+    const INESHeader &header = rom->get_header();
+
+    std::cerr << "Reading NES file [MAP:" << header.mapper
+        << "] - PRG:" << header.prg_rom_size/1024 << "KB, CHR:"
+        << header.chr_rom_size/1024 << "KB" << std::endl;
+
+    CartridgeMemory mem{};
+    mem.prg_rom = rom->prg_data();
+    mem.prg_rom_size = header.prg_rom_size;
+    if (header.chr_rom_size == 0)
     {
-        throw std::runtime_error("Failed to open ROM file.");
+        chr_ram.resize(header.chr_ram_size ? header.chr_ram_size : 1<<13);
+        mem.chr_ram = chr_ram.data();
+        mem.chr_size = chr_ram.size();
     }
-    uint8_t header[16];
-    file.read(reinterpret_cast<char*>(header), 16);
-    if (file.gcount() != 16
-        || header[0] != 'N' || header[1] != 'E' || header[2] != 'S'
-        || header[3] != 0x1A)
+    else
     {
-        throw std::runtime_error("Invalid iNES file.");
+        mem.chr_rom = rom->chr_data();
+        mem.chr_size = header.chr_rom_size;
     }
-    
-    int prg_rom_kb = header[4]*16*1024;
-    int chr_rom_kb = header[5]*8*1024;
-    uint8_t mapper = header[7]&0xF0 | (header[6]>>4);
-    std::cout << "Reading NES file [MAP:" << (int)mapper
-        << "] - PRG:" << prg_rom_kb/1024 << "KB, CHR:"
-        << chr_rom_kb/1024 << "KB" << std::endl;
+    mem.vram = vram.data();
+    mem.mirroring = header.mirroring;
 
-    prg_rom.load_binary_region(rom_path, 16, prg_rom_kb);
-    chr_rom.load_binary_region(rom_path, 16 + prg_rom_kb, chr_rom_kb);
+    mapper = Mapper::create(header.mapper, mem);
+
+    // $6000-$7FFF is always backed so games probing for RAM see some
+    std::size_t prg_ram_size = std::max<std::size_t>(header.prg_ram_size + header.prg_nvram_size, 1<<13);
+    if (header.battery)
+    {
+        std::string save_path = std::filesystem::path(rom_path).replace_extension(".sav").string();
+        prg_ram = std::make_unique<SaveRam>(prg_ram_size, save_path, save_flush_interval);
+    }
+    else
+    {
+        prg_ram = std::make_unique<SaveRam>(prg_ram_size);
+    }
 }
 
-Cartridge::PRGROM *Cartridge::prg_ref()
+Mapper::PRGWindow *Cartridge::prg_ref()
+{
+    return mapper->prg_ref();
+}
+Mapper::CHRWindow *Cartridge::chr_ref()
+{
+    return mapper->chr_ref();
+}
+Mapper::NametableWindow *Cartridge::vram_ref()
+{
+    return mapper->nametable_ref();
+}
+const Cartridge::VRAM &Cartridge::vram_data() const
 {
-    return &prg_rom;
+    return vram;
 }
-Cartridge::CHRROM *Cartridge::chr_ref()
+void Cartridge::save_state(StateWriter &writer) const
 {
-    return &chr_rom;
+    writer.write_bytes(vram.data(), vram.size());
+    writer.write_bytes(chr_ram.data(), chr_ram.size());
+    prg_ram->save_state(writer);
+    mapper->save_state(writer);
 }
-Cartridge::VRAM *Cartridge::vram_ref()
+
+void Cartridge::load_state(StateReader &reader)
+{
+    reader.read_bytes(vram.data(), vram.size());
+    reader.read_bytes(chr_ram.data(), chr_ram.size());
+    prg_ram->load_state(reader);
+    mapper->load_state(reader);
+    mapper->nametable_ref()->dirty_ref()->mark_all();
+    mapper->chr_ref()->dirty_ref()->mark_all();
+}
+
+SaveRam *Cartridge::prg_ram_ref()
+{
+    return prg_ram.get();
+}
+Mapper *Cartridge::mapper_ref()
+{
+    return mapper.get();
+}
+
+uint32_t Cartridge::rom_crc32() const
+{
+    return rom->content_crc32();
+}
+
+uint32_t Cartridge::save_ram_crc32() const
 {
-    return &vram;
+    return prg_ram->content_crc32();
 }
\ No newline at end of file
@@ -0,0 +1,181 @@
+#include "checksum.h"
+
+#include <cstring>
+
+namespace
+{
+    struct CRC32Tables
+    {
+        uint32_t table[8][256];
+
+        constexpr CRC32Tables() :
+            table{}
+        {
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                uint32_t crc = i;
+                for (int bit = 0; bit < 8; ++bit)
+                {
+                    crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320u : 0);
+                }
+                table[0][i] = crc;
+            }
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                for (int slice = 1; slice < 8; ++slice)
+                {
+                    uint32_t prev = table[slice - 1][i];
+                    table[slice][i] = (prev >> 8) ^ table[0][prev & 0xFF];
+                }
+            }
+        }
+    };
+
+    constexpr CRC32Tables crc_tables;
+
+    uint32_t rotl(uint32_t value, int bits)
+    {
+        return (value << bits) | (value >> (32 - bits));
+    }
+}
+
+uint32_t crc32(const uint8_t *data, std::size_t size, uint32_t crc)
+{
+    const auto &t = crc_tables.table;
+    crc = ~crc;
+
+    // Consume 8 bytes per step using the 8 precomputed tables (little-endian).
+    while (size >= 8)
+    {
+        uint32_t lo;
+        uint32_t hi;
+        std::memcpy(&lo, data, 4);
+        std::memcpy(&hi, data + 4, 4);
+        lo ^= crc;
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF]
+            ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24]
+            ^ t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF]
+            ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+        data += 8;
+        size -= 8;
+    }
+    while (size--)
+    {
+        crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xFF];
+    }
+
+    return ~crc;
+}
+
+SHA1::SHA1() :
+    state{0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0},
+    block{}, block_len{0}, total_len{0}
+{}
+
+void SHA1::update(const uint8_t *data, std::size_t size)
+{
+    total_len += size;
+
+    if (block_len > 0)
+    {
+        std::size_t take = std::min(size, block.size() - block_len);
+        std::memcpy(block.data() + block_len, data, take);
+        block_len += take;
+        data += take;
+        size -= take;
+        if (block_len < block.size()) return;
+        process_block(block.data());
+        block_len = 0;
+    }
+
+    while (size >= block.size())
+    {
+        process_block(data);
+        data += block.size();
+        size -= block.size();
+    }
+
+    std::memcpy(block.data(), data, size);
+    block_len = size;
+}
+
+SHA1::Digest SHA1::finish()
+{
+    uint64_t bit_len = total_len * 8;
+
+    uint8_t padding[72] = {0x80};
+    std::size_t pad_len = (block_len < 56) ? (56 - block_len) : (120 - block_len);
+    for (int i = 0; i < 8; ++i)
+    {
+        padding[pad_len + i] = static_cast<uint8_t>(bit_len >> (56 - 8 * i));
+    }
+    update(padding, pad_len + 8);
+
+    Digest digest;
+    for (int i = 0; i < 20; ++i)
+    {
+        digest[i] = static_cast<uint8_t>(state[i / 4] >> (24 - 8 * (i % 4)));
+    }
+    return digest;
+}
+
+SHA1::Digest SHA1::hash(const uint8_t *data, std::size_t size)
+{
+    SHA1 sha;
+    sha.update(data, size);
+    return sha.finish();
+}
+
+void SHA1::process_block(const uint8_t *chunk)
+{
+    uint32_t w[80];
+    for (int i = 0; i < 16; ++i)
+    {
+        w[i] = (uint32_t(chunk[4*i]) << 24) | (uint32_t(chunk[4*i + 1]) << 16)
+            | (uint32_t(chunk[4*i + 2]) << 8) | uint32_t(chunk[4*i + 3]);
+    }
+    for (int i = 16; i < 80; ++i)
+    {
+        w[i] = rotl(w[i-3] ^ w[i-8] ^ w[i-14] ^ w[i-16], 1);
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+    for (int i = 0; i < 80; ++i)
+    {
+        uint32_t f;
+        uint32_t k;
+        if (i < 20)
+        {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        }
+        else if (i < 40)
+        {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        }
+        else if (i < 60)
+        {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        }
+        else
+        {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+
+        uint32_t temp = rotl(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = rotl(b, 30);
+        b = a;
+        a = temp;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
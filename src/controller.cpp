@@ -0,0 +1,55 @@
+#include "controller.h"
+
+Controller::Controller() :
+    buttons{}, shift{}, strobe{false}
+{}
+
+void Controller::set_buttons(int port, uint8_t state)
+{
+    buttons[port] = state;
+    if (strobe) shift[port] = state;
+}
+
+uint8_t Controller::get_buttons(int port) const
+{
+    return buttons[port];
+}
+
+uint8_t Controller::get(uint16_t addr)
+{
+    int port = addr & 0x1;
+    if (strobe)
+    {
+        return buttons[port] & 0x1;
+    }
+    uint8_t bit = shift[port] & 0x1;
+    // Official controllers return 1 once all eight buttons are read
+    shift[port] = (shift[port] >> 1) | 0x80;
+    return bit;
+}
+
+void Controller::set(uint16_t addr, uint8_t val)
+{
+    // $4017 writes belong to the APU frame counter
+    if (addr & 0x1) return;
+
+    strobe = val & 0x1;
+    if (strobe)
+    {
+        shift = buttons;
+    }
+}
+
+void Controller::save_state(StateWriter &writer) const
+{
+    writer.write(buttons);
+    writer.write(shift);
+    writer.write(strobe);
+}
+
+void Controller::load_state(StateReader &reader)
+{
+    reader.read(buttons);
+    reader.read(shift);
+    reader.read(strobe);
+}
@@ -1,5 +1,6 @@
 #include "cpu.h"
 #include "bus.h"
+#include "savestate.h"
 
 #include <iostream>
 #include <iomanip>
@@ -7,9 +8,19 @@
 CPU::CPU() :
     pc{}, a{}, x{}, y{}, s{}, p{},
     bus{nullptr}, ins_step{-1}, last_p{},
+    opcode{}, addr{}, buf{}, val{}, interrupt_vec{}, wb_cycle{},
     rst(false), irq(false), nmi(false)
 {}
 
+// Back to the constructed state, keeping the bus. This is not the 6502 reset
+// sequence, which is trigger_rst.
+void CPU::reset()
+{
+    Bus *attached = bus;
+    *this = CPU();
+    bus = attached;
+}
+
 void CPU::trigger_rst()
 {
     rst = true;
@@ -37,6 +48,21 @@ void CPU::load_json(nlohmann::json json)
     p.value = json["p"].get<uint8_t>();
 }
 
+CPURegisters CPU::get_registers() const
+{
+    return CPURegisters{pc, a, x, y, s, p.value};
+}
+
+void CPU::set_registers(const CPURegisters &regs)
+{
+    pc = regs.pc;
+    a = regs.a;
+    x = regs.x;
+    y = regs.y;
+    s = regs.s;
+    p.value = regs.p;
+}
+
 void CPU::attach_bus(Bus *new_bus)
 {
     bus = new_bus;
@@ -47,6 +73,65 @@ bool CPU::mid_instruction()
     return ins_step >= 0;
 }
 
+// The instruction being executed; 0 (BRK) while entering an interrupt
+uint8_t CPU::get_opcode() const
+{
+    return opcode;
+}
+
+// Whether the next instruction start will enter an interrupt instead
+bool CPU::interrupt_pending() const
+{
+    return rst || nmi || irq;
+}
+
+uint16_t CPU::get_interrupt_vector() const
+{
+    return interrupt_vec;
+}
+
+void CPU::save_state(StateWriter &writer) const
+{
+    writer.write(pc);
+    writer.write(a);
+    writer.write(x);
+    writer.write(y);
+    writer.write(s);
+    writer.write(p.value);
+    writer.write(ins_step);
+    writer.write(last_p.value);
+    writer.write(opcode);
+    writer.write(addr);
+    writer.write(buf);
+    writer.write(val);
+    writer.write(interrupt_vec);
+    writer.write(wb_cycle);
+    writer.write(rst);
+    writer.write(irq);
+    writer.write(nmi);
+}
+
+void CPU::load_state(StateReader &reader)
+{
+    reader.read(pc);
+    reader.read(a);
+    reader.read(x);
+    reader.read(y);
+    reader.read(s);
+    reader.read(p.value);
+    reader.read(ins_step);
+    reader.read(last_p.value);
+    reader.read(opcode);
+    reader.read(addr);
+    reader.read(buf);
+    reader.read(val);
+    reader.read(interrupt_vec);
+    reader.read(wb_cycle);
+    reader.read(rst);
+    reader.read(irq);
+    reader.read(nmi);
+}
+
 bool CPU::verify_state(nlohmann::json json)
 {
     return json["pc"] == pc &&
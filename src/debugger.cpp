@@ -0,0 +1,95 @@
+#include "debugger.h"
+
+Debugger::Debugger() :
+    breakpoints{}, breakpoint_count{0},
+    break_requested{false}, paused{false}, resuming{false}, visible{false},
+    snapshot{}, cpu_heatmap{nullptr}, ppu_heatmap{nullptr}
+{}
+
+void Debugger::set_breakpoint(uint16_t addr, bool enabled)
+{
+    if (breakpoints[addr] == enabled) return;
+    breakpoints[addr] = enabled;
+    if (enabled)
+    {
+        ++breakpoint_count;
+    }
+    else
+    {
+        --breakpoint_count;
+    }
+}
+
+bool Debugger::has_breakpoint(uint16_t addr) const
+{
+    return breakpoints[addr];
+}
+
+void Debugger::clear_breakpoints()
+{
+    breakpoints.reset();
+    breakpoint_count = 0;
+    resuming = false;
+}
+
+// Pauses at the next instruction boundary
+void Debugger::request_break()
+{
+    if (!paused)
+    {
+        break_requested = true;
+    }
+}
+
+void Debugger::resume()
+{
+    if (paused)
+    {
+        paused = false;
+        resuming = breakpoint_count > 0;
+    }
+}
+
+bool Debugger::is_paused() const
+{
+    return paused;
+}
+
+// Snapshots are only taken while the panels are shown
+void Debugger::set_visible(bool visible)
+{
+    this->visible = visible;
+}
+
+bool Debugger::is_visible() const
+{
+    return visible;
+}
+
+DebugSnapshot *Debugger::snapshot_ref()
+{
+    return &snapshot;
+}
+
+const DebugSnapshot *Debugger::snapshot_ref() const
+{
+    return &snapshot;
+}
+
+// The heatmaps are counted between frames on the emulation thread and only
+// read by the panels, so they are shown live rather than snapshotted
+void Debugger::set_heatmaps(const AccessHeatmap *cpu, const AccessHeatmap *ppu)
+{
+    cpu_heatmap = cpu;
+    ppu_heatmap = ppu;
+}
+
+const AccessHeatmap *Debugger::cpu_heatmap_ref() const
+{
+    return cpu_heatmap;
+}
+
+const AccessHeatmap *Debugger::ppu_heatmap_ref() const
+{
+    return ppu_heatmap;
+}
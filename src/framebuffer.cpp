@@ -0,0 +1,24 @@
+#include "framebuffer.h"
+
+// Transposes in square tiles so both the column reads and row writes stay
+// within a few cache lines.
+static constexpr int TILE = 16;
+static_assert(RESOLUTION_X % TILE == 0 && RESOLUTION_Y % TILE == 0, "Resolution must be whole tiles");
+
+void convert_framebuffer(const PPU::Display &display, uint32_t *pixels)
+{
+    for (int tile_y = 0; tile_y < RESOLUTION_Y; tile_y += TILE)
+    {
+        for (int tile_x = 0; tile_x < RESOLUTION_X; tile_x += TILE)
+        {
+            for (int x = tile_x; x < tile_x + TILE; ++x)
+            {
+                const uint8_t *column = display[x].data();
+                for (int y = tile_y; y < tile_y + TILE; ++y)
+                {
+                    pixels[y * RESOLUTION_X + x] = column[y] ? FRAMEBUFFER_FOREGROUND : FRAMEBUFFER_BACKGROUND;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,85 @@
+#include "framestats.h"
+
+#include <algorithm>
+
+static constexpr double SMOOTHING = 0.05;
+
+FrameStats::FrameStats() :
+    frame_times{}, head{0},
+    frame_ms{0}, cycles_per_frame{0}, emulate_ms{0}, present_ms{0},
+    cpu_share{0.5}, cpu_share_valid{false}
+{}
+
+void FrameStats::record(double frame_ms, double emulate_ms, double present_ms, uint64_t cycles)
+{
+    frame_times[head] = static_cast<float>(frame_ms);
+    head = (head + 1) % HISTORY;
+
+    if (this->frame_ms == 0)
+    {
+        this->frame_ms = frame_ms;
+        this->cycles_per_frame = cycles;
+        this->emulate_ms = emulate_ms;
+        this->present_ms = present_ms;
+        return;
+    }
+    this->frame_ms += (frame_ms - this->frame_ms) * SMOOTHING;
+    this->cycles_per_frame += (cycles - this->cycles_per_frame) * SMOOTHING;
+    this->emulate_ms += (emulate_ms - this->emulate_ms) * SMOOTHING;
+    this->present_ms += (present_ms - this->present_ms) * SMOOTHING;
+}
+
+void FrameStats::set_cpu_share(double share)
+{
+    cpu_share = std::clamp(share, 0.0, 1.0);
+    cpu_share_valid = true;
+}
+
+void FrameStats::invalidate_cpu_share()
+{
+    cpu_share_valid = false;
+}
+
+// False before the first split frame, and while other frame types keep
+// pre-empting it, in which case the CPU/PPU figures are only a guess
+bool FrameStats::has_cpu_share() const
+{
+    return cpu_share_valid;
+}
+
+double FrameStats::fps() const
+{
+    return frame_ms > 0 ? 1000.0 / frame_ms : 0.0;
+}
+
+// Relative to a real NTSC console, 1.0 is full speed
+double FrameStats::speed() const
+{
+    return fps() / NTSC_FPS;
+}
+
+double FrameStats::cycles_per_second() const
+{
+    return cycles_per_frame * fps();
+}
+
+FrameTiming FrameStats::timing() const
+{
+    return FrameTiming{
+        emulate_ms * cpu_share,
+        emulate_ms * (1.0 - cpu_share),
+        present_ms,
+        std::max(frame_ms - emulate_ms - present_ms, 0.0)
+    };
+}
+
+// A ring of HISTORY frame times in milliseconds, oldest at history_offset()
+const float *FrameStats::frame_times_ref() const
+{
+    return frame_times.data();
+}
+
+std::size_t FrameStats::history_offset() const
+{
+    return head;
+}
@@ -0,0 +1,102 @@
+#include "heatmap.h"
+
+#include <algorithm>
+#include <fstream>
+#include <filesystem>
+#include <stdexcept>
+
+#include <cstring>
+
+namespace fs = std::filesystem;
+
+AccessHeatmap::AccessHeatmap(std::size_t size) :
+    size(size), suspended(false)
+{
+    for (auto &access : counts)
+    {
+        access.assign(size, 0);
+    }
+}
+
+std::size_t AccessHeatmap::get_size() const
+{
+    return size;
+}
+
+const uint32_t *AccessHeatmap::counts_ref(HeatmapAccess access) const
+{
+    return counts[access].data();
+}
+
+uint32_t AccessHeatmap::max_count(HeatmapAccess access) const
+{
+    return *std::max_element(counts[access].begin(), counts[access].end());
+}
+
+void AccessHeatmap::decay()
+{
+    for (auto &access : counts)
+    {
+        for (uint32_t &count : access)
+        {
+            count >>= 1;
+        }
+    }
+}
+
+void AccessHeatmap::clear()
+{
+    for (auto &access : counts)
+    {
+        std::fill(access.begin(), access.end(), 0);
+    }
+}
+
+void AccessHeatmap::set_suspended(bool suspended)
+{
+    this->suspended = suspended;
+}
+
+void AccessHeatmap::save(const std::string &path) const
+{
+    HeatmapHeader header{};
+    std::memcpy(header.magic, HeatmapHeader::MAGIC, sizeof(header.magic));
+    header.version = HeatmapHeader::VERSION;
+    header.size = static_cast<uint32_t>(size);
+
+    const std::string temp_path = path + ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::binary);
+        if (!file.is_open())
+        {
+            throw std::runtime_error("Failed to write heatmap " + path);
+        }
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        for (const auto &access : counts)
+        {
+            file.write(reinterpret_cast<const char *>(access.data()), access.size() * sizeof(uint32_t));
+        }
+    }
+    fs::rename(temp_path, path);
+}
+
+CountingDevice::CountingDevice(AddressMappedDevice *device, AccessHeatmap *heatmap, uint16_t base) :
+    device(device), heatmap(heatmap), base(base)
+{}
+
+AddressMappedDevice *CountingDevice::device_ref()
+{
+    return device;
+}
+
+uint8_t CountingDevice::get(uint16_t addr)
+{
+    heatmap->count(HEAT_READ, base + addr);
+    return device->get(addr);
+}
+
+void CountingDevice::set(uint16_t addr, uint8_t val)
+{
+    heatmap->count(HEAT_WRITE, base + addr);
+    device->set(addr, val);
+}
@@ -0,0 +1,86 @@
+#include "ines.h"
+
+#include <stdexcept>
+
+// NES 2.0 encodes large ROM sizes as 2^E * (M*2+1) when the MSB nibble is $F.
+static std::size_t nes2_rom_size(uint8_t lsb, uint8_t msb, std::size_t unit)
+{
+    if (msb == 0xF)
+    {
+        unsigned int exponent = lsb >> 2;
+        if (exponent > 30)
+        {
+            throw std::runtime_error("NES 2.0 ROM size out of range.");
+        }
+        return (std::size_t(1) << exponent) * ((lsb & 0x3) * 2 + 1);
+    }
+    return ((msb << 8) | lsb) * unit;
+}
+
+static std::size_t nes2_ram_size(uint8_t shift)
+{
+    return shift ? (std::size_t(64) << shift) : 0;
+}
+
+INESHeader parse_ines_header(const uint8_t *data, std::size_t size)
+{
+    if (size < INESHeader::SIZE
+        || data[0] != 'N' || data[1] != 'E' || data[2] != 'S'
+        || data[3] != 0x1A)
+    {
+        throw std::runtime_error("Invalid iNES file.");
+    }
+
+    INESHeader header{};
+    header.nes2 = (data[7] & 0x0C) == 0x08;
+    header.mapper = (data[7] & 0xF0) | (data[6] >> 4);
+    header.battery = data[6] & 0x02;
+    header.trainer = data[6] & 0x04;
+
+    if (header.nes2)
+    {
+        header.mapper |= (data[8] & 0x0F) << 8;
+        header.submapper = data[8] >> 4;
+        header.prg_rom_size = nes2_rom_size(data[4], data[9] & 0x0F, 1<<14);
+        header.chr_rom_size = nes2_rom_size(data[5], data[9] >> 4, 1<<13);
+        header.prg_ram_size = nes2_ram_size(data[10] & 0x0F);
+        header.prg_nvram_size = nes2_ram_size(data[10] >> 4);
+        header.chr_ram_size = nes2_ram_size(data[11] & 0x0F);
+    }
+    else
+    {
+        header.prg_rom_size = data[4] * (1<<14);
+        header.chr_rom_size = data[5] * (1<<13);
+        // iNES 1.0 treats 0 as 8 KB for compatibility
+        std::size_t prg_ram = (data[8] ? data[8] : 1) * (1<<13);
+        if (header.battery)
+        {
+            header.prg_nvram_size = prg_ram;
+        }
+        else
+        {
+            header.prg_ram_size = prg_ram;
+        }
+        header.chr_ram_size = (header.chr_rom_size == 0) ? (1<<13) : 0;
+    }
+
+    if (data[6] & 0x08)
+    {
+        header.mirroring = MirroringType::FOUR_SCREEN;
+    }
+    else
+    {
+        header.mirroring = (data[6] & 0x01) ? MirroringType::VERTICAL : MirroringType::HORIZONTAL;
+    }
+
+    if (header.prg_rom_size == 0)
+    {
+        throw std::runtime_error("iNES file has no PRG ROM.");
+    }
+    if (size < header.chr_offset() + header.chr_rom_size)
+    {
+        throw std::runtime_error("iNES file is shorter than its header describes.");
+    }
+
+    return header;
+}
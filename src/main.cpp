@@ -1,26 +1,387 @@
 #include "singlesteptests.h"
+#include "romlibrary.h"
 #include "nes.h"
 #include "window.h"
+#include "movie.h"
+#include "movieindex.h"
+#include "warmstart.h"
+#include "testroms.h"
+#include "rewindcheck.h"
+#include "trace.h"
 
 #include <string>
 #include <iostream>
+#include <chrono>
+#include <fstream>
+#include <memory>
+
+#include <cstdlib>
+
+// Writes the trace at exit; F3 in the window also writes it on demand
+static void enable_trace(const std::string &path)
+{
+#ifndef NES_TRACE
+    std::cerr << "Built without tracing, rebuild with make TRACE=1" << std::endl;
+#endif
+    Tracer::instance().set_output(path);
+    std::atexit([]() { Tracer::instance().write(); });
+}
 
 int main(int argc, char** argv)
 {
-    if (argc != 2)
+    if (argc < 2)
     {
-        std::cerr << "Must provide 1 argument" << std::endl;
+        std::cerr << "Must provide a mode argument" << std::endl;
+        return 1;
     }
     if (std::string(argv[1]) == "singlesteptests")
     {
-        const std::string single_step_dir = "external/65x02/nes6502/v1";
-        run_tests(single_step_dir);
+        std::string single_step_dir = "external/65x02/nes6502/v1";
+        std::string cache_dir = "cache/singlesteptests";
+        unsigned int threads = 0;
+        for (int i = 2; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            if (arg == "--threads" && i + 1 < argc)
+            {
+                threads = std::stoi(argv[++i]);
+            }
+            else if (arg == "--trace" && i + 1 < argc)
+            {
+                enable_trace(argv[++i]);
+            }
+            else if (arg == "--no-cache")
+            {
+                cache_dir.clear();
+            }
+            else
+            {
+                single_step_dir = arg;
+            }
+        }
+        run_tests(single_step_dir, threads, cache_dir);
     }
     else if (std::string(argv[1]) == "rom")
     {
-        const std::string rom_path = "roms/Donkey Kong (USA) (Rev 1) (e-Reader Edition).nes";
+        std::string rom_path = "roms/Donkey Kong (USA) (Rev 1) (e-Reader Edition).nes";
+        unsigned int run_ahead = 0;
+        std::string record_path;
+        std::string play_path;
+        unsigned int boot_frames = 0;
+        std::string profile_path;
+        unsigned int profile_interval = Profiler::DEFAULT_INTERVAL;
+        std::string opcode_stats_path;
+        std::string perf_log_path;
+        std::string heatmap_path;
+        unsigned int heatmap_decay = 60;
+        std::size_t rewind_mb = 0;
+        for (int i = 2; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            if (arg == "--run-ahead" && i + 1 < argc)
+            {
+                run_ahead = std::stoi(argv[++i]);
+            }
+            else if (arg == "--record" && i + 1 < argc)
+            {
+                record_path = argv[++i];
+            }
+            else if (arg == "--play" && i + 1 < argc)
+            {
+                play_path = argv[++i];
+            }
+            else if (arg == "--warm-start" && i + 1 < argc)
+            {
+                boot_frames = std::stoi(argv[++i]);
+            }
+            else if (arg == "--profile" && i + 1 < argc)
+            {
+                profile_path = argv[++i];
+            }
+            else if (arg == "--profile-interval" && i + 1 < argc)
+            {
+                profile_interval = std::stoi(argv[++i]);
+            }
+            else if (arg == "--opcode-stats" && i + 1 < argc)
+            {
+                opcode_stats_path = argv[++i];
+            }
+            else if (arg == "--perf-log" && i + 1 < argc)
+            {
+                perf_log_path = argv[++i];
+            }
+            else if (arg == "--heatmap" && i + 1 < argc)
+            {
+                heatmap_path = argv[++i];
+            }
+            else if (arg == "--heatmap-decay" && i + 1 < argc)
+            {
+                heatmap_decay = std::stoi(argv[++i]);
+            }
+            else if (arg == "--rewind" && i + 1 < argc)
+            {
+                rewind_mb = std::stoi(argv[++i]);
+            }
+            else if (arg == "--trace" && i + 1 < argc)
+            {
+                enable_trace(argv[++i]);
+            }
+            else
+            {
+                rom_path = arg;
+            }
+        }
+
         Window window(1024, 960);
         NES nes(&window, rom_path);
+        nes.set_run_ahead(run_ahead);
+
+        Movie movie;
+        if (!play_path.empty())
+        {
+            movie = Movie(play_path);
+            nes.play_movie(&movie);
+        }
+        else if (!record_path.empty())
+        {
+            nes.record_movie(&movie);
+        }
+
+        // Movies start from power-on, so they never warm start
+        if (boot_frames > 0 && play_path.empty() && record_path.empty())
+        {
+            WarmStart("cache/warmstart", boot_frames).start(nes);
+        }
+        else
+        {
+            nes.reset();
+        }
+        if (!profile_path.empty())
+        {
+            nes.enable_profiler(profile_interval);
+        }
+        if (!opcode_stats_path.empty())
+        {
+            nes.enable_opcode_stats();
+        }
+        if (!heatmap_path.empty())
+        {
+            nes.enable_heatmaps(heatmap_decay);
+        }
+        // Hold Backspace to rewind
+        if (rewind_mb > 0)
+        {
+            nes.enable_rewind(rewind_mb << 20);
+        }
+        std::ofstream perf_log;
+        if (!perf_log_path.empty())
+        {
+            perf_log.open(perf_log_path);
+            nes.set_perf_log(&perf_log);
+        }
         nes.run();
+        if (!record_path.empty())
+        {
+            movie.save(record_path);
+        }
+        if (!profile_path.empty())
+        {
+            nes.profiler_ref()->save(profile_path);
+        }
+        if (!opcode_stats_path.empty())
+        {
+            std::ofstream(opcode_stats_path) << nes.opcode_stats_ref()->to_json().dump(2) << std::endl;
+            nes.opcode_stats_ref()->write_report(std::cout);
+        }
+        if (!heatmap_path.empty())
+        {
+            nes.cpu_heatmap_ref()->save(heatmap_path + ".cpu.heat");
+            nes.ppu_heatmap_ref()->save(heatmap_path + ".ppu.heat");
+        }
+    }
+    else if (std::string(argv[1]) == "movie")
+    {
+        // Headless playback, for checking determinism against a hash log.
+        // --seek starts from a frame using the keyframe index next to the movie.
+        if (argc < 4)
+        {
+            std::cerr << "Usage: " << argv[0] << " movie <rom> <movie> [hash log]"
+                " [--seek frame] [--index-budget MB] [--profile prefix] [--opcode-stats file]"
+                " [--perf-log csv] [--trace json] [--heatmap prefix] [--heatmap-decay frames]" << std::endl;
+            return 1;
+        }
+        std::string hash_log_path;
+        uint64_t seek_frame = 0;
+        bool seek = false;
+        std::size_t index_budget = MovieIndex::DEFAULT_BUDGET;
+        std::string profile_path;
+        unsigned int profile_interval = Profiler::DEFAULT_INTERVAL;
+        std::string opcode_stats_path;
+        std::string perf_log_path;
+        std::string heatmap_path;
+        unsigned int heatmap_decay = 60;
+        for (int i = 4; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            if (arg == "--seek" && i + 1 < argc)
+            {
+                seek_frame = std::stoull(argv[++i]);
+                seek = true;
+            }
+            else if (arg == "--index-budget" && i + 1 < argc)
+            {
+                index_budget = std::stoull(argv[++i]) << 20;
+            }
+            else if (arg == "--profile" && i + 1 < argc)
+            {
+                profile_path = argv[++i];
+            }
+            else if (arg == "--profile-interval" && i + 1 < argc)
+            {
+                profile_interval = std::stoi(argv[++i]);
+            }
+            else if (arg == "--opcode-stats" && i + 1 < argc)
+            {
+                opcode_stats_path = argv[++i];
+            }
+            else if (arg == "--perf-log" && i + 1 < argc)
+            {
+                perf_log_path = argv[++i];
+            }
+            else if (arg == "--heatmap" && i + 1 < argc)
+            {
+                heatmap_path = argv[++i];
+            }
+            else if (arg == "--heatmap-decay" && i + 1 < argc)
+            {
+                heatmap_decay = std::stoi(argv[++i]);
+            }
+            else if (arg == "--trace" && i + 1 < argc)
+            {
+                enable_trace(argv[++i]);
+            }
+            else
+            {
+                hash_log_path = arg;
+            }
+        }
+
+        Movie movie(argv[3]);
+        NES nes(nullptr, argv[2]);
+        auto start = std::chrono::steady_clock::now();
+        if (seek)
+        {
+            MovieIndex index;
+            std::string index_path = MovieIndex::path_for(argv[3]);
+            if (!index.load(index_path, nes, movie))
+            {
+                index.build(nes, movie, index_budget);
+                index.save(index_path, nes, movie);
+                std::cout << "Built index with " << index.keyframe_count() << " keyframes every "
+                    << index.get_interval() << " frames" << std::endl;
+                start = std::chrono::steady_clock::now();
+            }
+            nes.play_movie(&movie);
+            index.seek(nes, seek_frame);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << "Seeked to frame " << seek_frame << " in " << elapsed.count() << "s" << std::endl;
+        }
+        else
+        {
+            nes.play_movie(&movie);
+            nes.reset();
+        }
+
+        std::ofstream hash_log;
+        if (!hash_log_path.empty())
+        {
+            hash_log.open(hash_log_path);
+            nes.set_hash_log(&hash_log);
+        }
+        if (!profile_path.empty())
+        {
+            nes.enable_profiler(profile_interval);
+        }
+        if (!opcode_stats_path.empty())
+        {
+            nes.enable_opcode_stats();
+        }
+        if (!heatmap_path.empty())
+        {
+            nes.enable_heatmaps(heatmap_decay);
+        }
+        std::ofstream perf_log;
+        if (!perf_log_path.empty())
+        {
+            perf_log.open(perf_log_path);
+            nes.set_perf_log(&perf_log);
+        }
+        start = std::chrono::steady_clock::now();
+        uint64_t first_frame = nes.get_frame();
+        while (!nes.movie_finished())
+        {
+            nes.step_frame();
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "Played " << nes.get_frame() - first_frame << " frames in " << elapsed.count() << "s" << std::endl;
+        if (!profile_path.empty())
+        {
+            nes.profiler_ref()->save(profile_path);
+        }
+        if (!opcode_stats_path.empty())
+        {
+            std::ofstream(opcode_stats_path) << nes.opcode_stats_ref()->to_json().dump(2) << std::endl;
+            nes.opcode_stats_ref()->write_report(std::cout);
+        }
+        if (!heatmap_path.empty())
+        {
+            nes.cpu_heatmap_ref()->save(heatmap_path + ".cpu.heat");
+            nes.ppu_heatmap_ref()->save(heatmap_path + ".ppu.heat");
+        }
+    }
+    else if (std::string(argv[1]) == "testroms")
+    {
+        std::string manifest = "external/nes-test-roms.txt";
+        unsigned int threads = 0;
+        for (int i = 2; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            if (arg == "--threads" && i + 1 < argc)
+            {
+                threads = std::stoi(argv[++i]);
+            }
+            else if (arg == "--trace" && i + 1 < argc)
+            {
+                enable_trace(argv[++i]);
+            }
+            else
+            {
+                manifest = arg;
+            }
+        }
+        return run_test_roms(manifest, threads) ? 0 : 1;
+    }
+    else if (std::string(argv[1]) == "rewindcheck")
+    {
+        if (argc < 3)
+        {
+            std::cerr << "Usage: " << argv[0] << " rewindcheck <rom> [frames]" << std::endl;
+            return 1;
+        }
+        unsigned int frames = (argc > 3) ? std::stoi(argv[3]) : 300;
+        return check_rewind(argv[2], frames) ? 0 : 1;
+    }
+    else if (std::string(argv[1]) == "index")
+    {
+        if (argc != 4)
+        {
+            std::cerr << "Usage: " << argv[0] << " index <rom dir> <index file>" << std::endl;
+            return 1;
+        }
+        auto start = std::chrono::steady_clock::now();
+        RomScanStats stats = index_rom_library(argv[2], argv[3]);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "Indexed " << stats.hashed << " new, " << stats.reused << " unchanged, "
+            << stats.failed << " skipped in " << elapsed.count() << "s" << std::endl;
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,449 @@
+#include "mapper.h"
+
+#include <stdexcept>
+#include <string>
+#include <algorithm>
+
+Mapper::Mapper(const CartridgeMemory &mem) :
+    mem(mem), prg{}, chr{}, nametables{}
+{
+    prg.attach_register_port(this);
+    nametables.track_ram(mem.vram, 1<<12);
+    if (mem.chr_ram)
+    {
+        chr.track_ram(mem.chr_ram, mem.chr_size);
+    }
+    set_mirroring(mem.mirroring);
+}
+
+std::unique_ptr<Mapper> Mapper::create(int id, const CartridgeMemory &mem)
+{
+    switch (id)
+    {
+    case 0: return std::make_unique<NROM>(mem);
+    case 1: return std::make_unique<MMC1>(mem);
+    case 2: return std::make_unique<UxROM>(mem);
+    case 3: return std::make_unique<CNROM>(mem);
+    case 4: return std::make_unique<MMC3>(mem);
+    case 7: return std::make_unique<AxROM>(mem);
+    default:
+        throw std::runtime_error("Unsupported mapper " + std::to_string(id));
+    }
+}
+
+Mapper::PRGWindow *Mapper::prg_ref()
+{
+    return &prg;
+}
+
+Mapper::CHRWindow *Mapper::chr_ref()
+{
+    return &chr;
+}
+
+Mapper::NametableWindow *Mapper::nametable_ref()
+{
+    return &nametables;
+}
+
+// The 8 KB PRG ROM bank mapped at addr ($8000-$FFFF), so tools can tell
+// banked code at the same address apart
+int Mapper::prg_bank(uint16_t addr) const
+{
+    const uint8_t *bank = prg.bank_ref((addr & 0x7FFF) / PRGWindow::BANK_SIZE);
+    return (bank - mem.prg_rom) / PRGWindow::BANK_SIZE;
+}
+
+uint8_t Mapper::get(uint16_t addr)
+{
+    // Reads never reach the register port, the PRG window serves them.
+    return 0;
+}
+
+void Mapper::clock_scanline()
+{}
+
+bool Mapper::irq_pending()
+{
+    return false;
+}
+
+// Points `slots` consecutive window slots at bank `bank` of that size.
+// Negative banks count back from the end of the ROM.
+void Mapper::map_prg(unsigned int slot, unsigned int slots, int bank)
+{
+    std::size_t units = std::max<std::size_t>(mem.prg_rom_size / PRGWindow::BANK_SIZE, 1);
+    if (bank < 0)
+    {
+        bank += std::max<std::size_t>(units / slots, 1);
+    }
+    for (unsigned int i = 0; i < slots; ++i)
+    {
+        std::size_t unit = (static_cast<std::size_t>(bank) * slots + i) % units;
+        prg.map_rom_bank(slot + i, mem.prg_rom + unit * PRGWindow::BANK_SIZE);
+    }
+}
+
+void Mapper::map_chr(unsigned int slot, unsigned int slots, int bank)
+{
+    std::size_t units = std::max<std::size_t>(mem.chr_size / CHRWindow::BANK_SIZE, 1);
+    if (bank < 0)
+    {
+        bank += std::max<std::size_t>(units / slots, 1);
+    }
+    for (unsigned int i = 0; i < slots; ++i)
+    {
+        std::size_t offset = ((static_cast<std::size_t>(bank) * slots + i) % units) * CHRWindow::BANK_SIZE;
+        if (mem.chr_ram)
+        {
+            chr.map_ram_bank(slot + i, mem.chr_ram + offset);
+        }
+        else
+        {
+            chr.map_rom_bank(slot + i, mem.chr_rom + offset);
+        }
+    }
+}
+
+void Mapper::set_mirroring(MirroringType mirroring)
+{
+    static constexpr unsigned int layouts[][4] = {
+        {0, 0, 1, 1}, // HORIZONTAL
+        {0, 1, 0, 1}, // VERTICAL
+        {0, 0, 0, 0}, // SINGLE_SCREEN_LOW
+        {1, 1, 1, 1}, // SINGLE_SCREEN_HIGH
+        {0, 1, 2, 3}  // FOUR_SCREEN
+    };
+
+    for (unsigned int i = 0; i < 4; ++i)
+    {
+        nametables.map_ram_bank(i, mem.vram + layouts[mirroring][i] * NametableWindow::BANK_SIZE);
+    }
+}
+
+NROM::NROM(const CartridgeMemory &mem) :
+    Mapper(mem)
+{
+    update_banks();
+}
+
+void NROM::set(uint16_t addr, uint8_t val)
+{}
+
+void NROM::update_banks()
+{
+    // NROM-128 mirrors its single 16 KB bank into $C000
+    map_prg(0, 2, 0);
+    map_prg(2, 2, -1);
+    map_chr(0, 8, 0);
+}
+
+void NROM::save_state(StateWriter &writer) const
+{}
+
+void NROM::load_state(StateReader &reader)
+{}
+
+MMC1::MMC1(const CartridgeMemory &mem) :
+    Mapper(mem),
+    shift{0x10}, control{0x0C},
+    chr_bank0{}, chr_bank1{}, prg_bank{}
+{
+    update_banks();
+}
+
+void MMC1::set(uint16_t addr, uint8_t val)
+{
+    if (val & 0x80)
+    {
+        shift = 0x10;
+        control |= 0x0C;
+        update_banks();
+        return;
+    }
+
+    // The marker bit reaches bit 0 once four bits have been shifted in.
+    bool complete = shift & 0x1;
+    shift = (shift >> 1) | ((val & 0x1) << 4);
+    if (!complete) return;
+
+    switch ((addr >> 13) & 0x3)
+    {
+    case 0: control = shift; break;
+    case 1: chr_bank0 = shift; break;
+    case 2: chr_bank1 = shift; break;
+    case 3: prg_bank = shift; break;
+    }
+    shift = 0x10;
+    update_banks();
+}
+
+void MMC1::update_banks()
+{
+    static constexpr MirroringType mirroring[] = {
+        MirroringType::SINGLE_SCREEN_LOW, MirroringType::SINGLE_SCREEN_HIGH,
+        MirroringType::VERTICAL, MirroringType::HORIZONTAL
+    };
+    set_mirroring(mirroring[control & 0x3]);
+
+    // SUROM uses CHR bank bit 4 to select the 256 KB half of a 512 KB PRG ROM
+    int outer = (mem.prg_rom_size > (1<<18)) ? (chr_bank0 & 0x10) : 0;
+    switch ((control >> 2) & 0x3)
+    {
+    case 0:
+    case 1:
+        map_prg(0, 4, (outer | (prg_bank & 0x0E)) >> 1);
+        break;
+    case 2:
+        map_prg(0, 2, outer);
+        map_prg(2, 2, outer | (prg_bank & 0x0F));
+        break;
+    case 3:
+        map_prg(0, 2, outer | (prg_bank & 0x0F));
+        map_prg(2, 2, outer | 0x0F);
+        break;
+    }
+
+    if (control & 0x10)
+    {
+        map_chr(0, 4, chr_bank0);
+        map_chr(4, 4, chr_bank1);
+    }
+    else
+    {
+        map_chr(0, 8, chr_bank0 >> 1);
+    }
+}
+
+void MMC1::save_state(StateWriter &writer) const
+{
+    writer.write(shift);
+    writer.write(control);
+    writer.write(chr_bank0);
+    writer.write(chr_bank1);
+    writer.write(prg_bank);
+}
+
+void MMC1::load_state(StateReader &reader)
+{
+    reader.read(shift);
+    reader.read(control);
+    reader.read(chr_bank0);
+    reader.read(chr_bank1);
+    reader.read(prg_bank);
+    update_banks();
+}
+
+UxROM::UxROM(const CartridgeMemory &mem) :
+    Mapper(mem), prg_bank{}
+{
+    update_banks();
+}
+
+void UxROM::set(uint16_t addr, uint8_t val)
+{
+    prg_bank = val;
+    map_prg(0, 2, prg_bank);
+}
+
+void UxROM::update_banks()
+{
+    map_prg(0, 2, prg_bank);
+    map_prg(2, 2, -1);
+    map_chr(0, 8, 0);
+}
+
+void UxROM::save_state(StateWriter &writer) const
+{
+    writer.write(prg_bank);
+}
+
+void UxROM::load_state(StateReader &reader)
+{
+    reader.read(prg_bank);
+    update_banks();
+}
+
+CNROM::CNROM(const CartridgeMemory &mem) :
+    Mapper(mem), chr_bank{}
+{
+    update_banks();
+}
+
+void CNROM::set(uint16_t addr, uint8_t val)
+{
+    chr_bank = val;
+    map_chr(0, 8, chr_bank);
+}
+
+void CNROM::update_banks()
+{
+    map_prg(0, 2, 0);
+    map_prg(2, 2, -1);
+    map_chr(0, 8, chr_bank);
+}
+
+void CNROM::save_state(StateWriter &writer) const
+{
+    writer.write(chr_bank);
+}
+
+void CNROM::load_state(StateReader &reader)
+{
+    reader.read(chr_bank);
+    update_banks();
+}
+
+MMC3::MMC3(const CartridgeMemory &mem) :
+    Mapper(mem),
+    bank_select{}, bank_regs{}, mirroring_reg{}, prg_ram_protect{},
+    irq_latch{}, irq_counter{}, irq_reload{false},
+    irq_enabled{false}, irq_flag{false}
+{
+    update_banks();
+}
+
+void MMC3::set(uint16_t addr, uint8_t val)
+{
+    switch (addr & 0x6001)
+    {
+    case 0x0000: // Bank select
+        bank_select = val;
+        break;
+    case 0x0001: // Bank data
+        bank_regs[bank_select & 0x7] = val;
+        break;
+    case 0x2000: // Mirroring
+        mirroring_reg = val & 0x1;
+        break;
+    case 0x2001: // PRG-RAM protect
+        prg_ram_protect = val;
+        return;
+    case 0x4000: // IRQ latch
+        irq_latch = val;
+        return;
+    case 0x4001: // IRQ reload
+        irq_counter = 0;
+        irq_reload = true;
+        return;
+    case 0x6000: // IRQ disable
+        irq_enabled = false;
+        irq_flag = false;
+        return;
+    case 0x6001: // IRQ enable
+        irq_enabled = true;
+        return;
+    }
+    update_banks();
+}
+
+void MMC3::update_banks()
+{
+    if (mem.mirroring != MirroringType::FOUR_SCREEN)
+    {
+        set_mirroring(mirroring_reg ? MirroringType::HORIZONTAL : MirroringType::VERTICAL);
+    }
+
+    if (bank_select & 0x40)
+    {
+        map_prg(0, 1, -2);
+        map_prg(2, 1, bank_regs[6]);
+    }
+    else
+    {
+        map_prg(0, 1, bank_regs[6]);
+        map_prg(2, 1, -2);
+    }
+    map_prg(1, 1, bank_regs[7]);
+    map_prg(3, 1, -1);
+
+    // R0/R1 select 2 KB banks, R2-R5 1 KB banks; bit 7 swaps the halves.
+    unsigned int two_kb = (bank_select & 0x80) ? 4 : 0;
+    unsigned int one_kb = (bank_select & 0x80) ? 0 : 4;
+    map_chr(two_kb, 2, bank_regs[0] >> 1);
+    map_chr(two_kb + 2, 2, bank_regs[1] >> 1);
+    for (unsigned int i = 0; i < 4; ++i)
+    {
+        map_chr(one_kb + i, 1, bank_regs[2 + i]);
+    }
+}
+
+void MMC3::save_state(StateWriter &writer) const
+{
+    writer.write(bank_select);
+    writer.write(bank_regs);
+    writer.write(mirroring_reg);
+    writer.write(prg_ram_protect);
+    writer.write(irq_latch);
+    writer.write(irq_counter);
+    writer.write(irq_reload);
+    writer.write(irq_enabled);
+    writer.write(irq_flag);
+}
+
+void MMC3::load_state(StateReader &reader)
+{
+    reader.read(bank_select);
+    reader.read(bank_regs);
+    reader.read(mirroring_reg);
+    reader.read(prg_ram_protect);
+    reader.read(irq_latch);
+    reader.read(irq_counter);
+    reader.read(irq_reload);
+    reader.read(irq_enabled);
+    reader.read(irq_flag);
+    update_banks();
+}
+
+void MMC3::clock_scanline()
+{
+    if (irq_counter == 0 || irq_reload)
+    {
+        irq_counter = irq_latch;
+        irq_reload = false;
+    }
+    else
+    {
+        irq_counter--;
+    }
+
+    if (irq_counter == 0 && irq_enabled)
+    {
+        irq_flag = true;
+    }
+}
+
+bool MMC3::irq_pending()
+{
+    return irq_flag;
+}
+
+AxROM::AxROM(const CartridgeMemory &mem) :
+    Mapper(mem), bank{}
+{
+    update_banks();
+}
+
+void AxROM::set(uint16_t addr, uint8_t val)
+{
+    bank = val;
+    update_banks();
+}
+
+void AxROM::update_banks()
+{
+    map_prg(0, 4, bank & 0x7);
+    map_chr(0, 8, 0);
+    set_mirroring((bank & 0x10) ? MirroringType::SINGLE_SCREEN_HIGH : MirroringType::SINGLE_SCREEN_LOW);
+}
+
+void AxROM::save_state(StateWriter &writer) const
+{
+    writer.write(bank);
+}
+
+void AxROM::load_state(StateReader &reader)
+{
+    reader.read(bank);
+    update_banks();
+}
@@ -0,0 +1,150 @@
+#include "movie.h"
+
+#include <stdexcept>
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+
+struct MovieHeader
+{
+    char magic[4];
+    uint16_t version;
+    uint16_t ports;
+    uint32_t frame_count;
+    uint32_t rom_crc;
+};
+
+Movie::Movie() :
+    rom_crc{0}, frames{}
+{}
+
+Movie::Movie(const std::string &path) :
+    Movie()
+{
+    if (std::filesystem::path(path).extension() == ".fm2")
+    {
+        load_fm2(path);
+    }
+    else
+    {
+        load_native(path);
+    }
+}
+
+void Movie::save(const std::string &path) const
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Failed to write movie: " + path);
+    }
+
+    MovieHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(header.magic));
+    header.version = VERSION;
+    header.ports = 2;
+    header.frame_count = frames.size();
+    header.rom_crc = rom_crc;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(frames.data()), frames.size() * sizeof(Input));
+}
+
+std::size_t Movie::frame_count() const
+{
+    return frames.size();
+}
+
+const Movie::Input &Movie::frame(std::size_t i) const
+{
+    return frames[i];
+}
+
+void Movie::append(const Input &input)
+{
+    frames.push_back(input);
+}
+
+void Movie::truncate(std::size_t count)
+{
+    if (count < frames.size())
+    {
+        frames.resize(count);
+    }
+}
+
+uint32_t Movie::get_rom_crc() const
+{
+    return rom_crc;
+}
+
+void Movie::set_rom_crc(uint32_t crc)
+{
+    rom_crc = crc;
+}
+
+void Movie::load_native(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Failed to open movie: " + path);
+    }
+
+    MovieHeader header{};
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || std::memcmp(header.magic, MAGIC, sizeof(header.magic)) != 0
+        || header.version != VERSION || header.ports != 2)
+    {
+        throw std::runtime_error("Invalid movie file: " + path);
+    }
+
+    rom_crc = header.rom_crc;
+    frames.resize(header.frame_count);
+    file.read(reinterpret_cast<char*>(frames.data()), frames.size() * sizeof(Input));
+    if (!file)
+    {
+        throw std::runtime_error("Movie file is truncated: " + path);
+    }
+}
+
+// FM2 input lines look like |commands|RLDUTSBA|RLDUTSBA|port2|, where any
+// character other than '.' or ' ' marks a pressed button.
+void Movie::load_fm2(const std::string &path)
+{
+    std::ifstream file(path);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Failed to open movie: " + path);
+    }
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.rfind("binary 1", 0) == 0)
+        {
+            throw std::runtime_error("Binary FM2 movies are not supported: " + path);
+        }
+        if (line.empty() || line[0] != '|') continue;
+
+        Input input{};
+        std::size_t field_start = line.find('|', 1);
+        for (int port = 0; port < 2 && field_start != std::string::npos; ++port)
+        {
+            std::size_t field_end = line.find('|', field_start + 1);
+            if (field_end == std::string::npos) break;
+            if (field_end - field_start - 1 == 8)
+            {
+                for (int i = 0; i < 8; ++i)
+                {
+                    char c = line[field_start + 1 + i];
+                    if (c != '.' && c != ' ')
+                    {
+                        input[port] |= 0x80 >> i;
+                    }
+                }
+            }
+            field_start = field_end;
+        }
+        frames.push_back(input);
+    }
+}
@@ -0,0 +1,166 @@
+#include "movieindex.h"
+#include "movie.h"
+#include "nes.h"
+#include "checksum.h"
+
+#include <stdexcept>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <cstring>
+
+namespace fs = std::filesystem;
+
+struct MovieIndexHeader
+{
+    char magic[8];
+    uint16_t version;
+    uint16_t state_version;
+    uint32_t rom_crc;
+    uint32_t movie_crc; // Of every frame's input, so an edited movie is rebuilt
+    uint32_t frame_count;
+    uint32_t interval;
+    uint32_t keyframe_count;
+    uint32_t reserved;
+    uint64_t state_size;
+};
+
+static uint32_t movie_crc32(const Movie &movie)
+{
+    uint32_t crc = 0;
+    for (std::size_t i = 0; i < movie.frame_count(); ++i)
+    {
+        crc = crc32(movie.frame(i).data(), sizeof(Movie::Input), crc);
+    }
+    return crc;
+}
+
+MovieIndex::MovieIndex() :
+    interval{1}, state_size{0}, keyframes{}
+{}
+
+std::string MovieIndex::path_for(const std::string &movie_path)
+{
+    return movie_path + ".idx";
+}
+
+// Smallest interval whose keyframes fit the budget, always keeping frame 0
+uint32_t MovieIndex::interval_for(std::size_t frames, std::size_t state_size, std::size_t budget)
+{
+    std::size_t max_keyframes = std::max<std::size_t>(budget / state_size, 1);
+    std::size_t interval = (frames + max_keyframes - 1) / max_keyframes;
+    return std::max<std::size_t>(interval, 1);
+}
+
+// Plays the movie from power-on with rendering off, capturing a keyframe at
+// the start of every interval-th frame.
+void MovieIndex::build(NES &nes, const Movie &movie, std::size_t budget)
+{
+    state_size = nes.state_size();
+    interval = interval_for(movie.frame_count(), state_size, budget);
+    keyframes.assign((movie.frame_count() / interval + 1) * state_size, 0);
+
+    nes.play_movie(&movie);
+    nes.reset();
+    for (std::size_t i = 0; i < keyframe_count(); ++i)
+    {
+        nes.fast_forward(i * interval);
+        nes.save_state(keyframes.data() + i * state_size, state_size);
+    }
+}
+
+// Returns false when there is no index, it was built for another ROM, movie
+// or state format, or it is truncated or corrupt
+bool MovieIndex::load(const std::string &path, const NES &nes, const Movie &movie)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) return false;
+    uint64_t file_size = file.tellg();
+    file.seekg(0);
+
+    MovieIndexHeader header{};
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || std::memcmp(header.magic, MAGIC, sizeof(header.magic)) != 0
+        || header.version != VERSION
+        || header.state_version != NES::STATE_VERSION
+        || header.rom_crc != nes.rom_crc32()
+        || header.frame_count != movie.frame_count()
+        || header.movie_crc != movie_crc32(movie)
+        || header.state_size != nes.state_size()
+        || header.interval == 0)
+    {
+        return false;
+    }
+    // Checked before allocating, so a corrupt count is a rebuild, not a huge allocation
+    uint64_t data_size = file_size - sizeof(header);
+    if (header.keyframe_count != header.frame_count / header.interval + 1
+        || header.keyframe_count > data_size / header.state_size
+        || header.keyframe_count * header.state_size != data_size)
+    {
+        return false;
+    }
+
+    std::vector<uint8_t> data(header.keyframe_count * header.state_size);
+    file.read(reinterpret_cast<char*>(data.data()), data.size());
+    if (!file) return false;
+
+    interval = header.interval;
+    state_size = header.state_size;
+    keyframes = std::move(data);
+    return true;
+}
+
+// Written to a temporary file and renamed, so an interrupted save never
+// leaves a partial index behind
+void MovieIndex::save(const std::string &path, const NES &nes, const Movie &movie) const
+{
+    const std::string temp_path = path + ".tmp";
+    std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Failed to write movie index: " + temp_path);
+    }
+
+    MovieIndexHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(header.magic));
+    header.version = VERSION;
+    header.state_version = NES::STATE_VERSION;
+    header.rom_crc = nes.rom_crc32();
+    header.movie_crc = movie_crc32(movie);
+    header.frame_count = movie.frame_count();
+    header.interval = interval;
+    header.keyframe_count = keyframe_count();
+    header.state_size = state_size;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(keyframes.data()), keyframes.size());
+    file.close();
+    if (!file)
+    {
+        throw std::runtime_error("Failed to write movie index: " + temp_path);
+    }
+    fs::rename(temp_path, path);
+}
+
+// Leaves the NES at the start of `frame`, as if the movie had been played up
+// to it. The movie must already be attached with play_movie.
+void MovieIndex::seek(NES &nes, uint64_t frame) const
+{
+    if (keyframes.empty())
+    {
+        throw std::runtime_error("Movie index has not been built.");
+    }
+    std::size_t i = std::min<std::size_t>(frame / interval, keyframe_count() - 1);
+    nes.load_state(keyframes.data() + i * state_size, state_size);
+    nes.set_frame(i * interval);
+    nes.fast_forward(frame);
+}
+
+uint32_t MovieIndex::get_interval() const
+{
+    return interval;
+}
+
+std::size_t MovieIndex::keyframe_count() const
+{
+    return state_size ? keyframes.size() / state_size : 0;
+}
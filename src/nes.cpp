@@ -1,48 +1,711 @@
 #include "nes.h"
 #include "window.h"
+#include "savestate.h"
+#include "checksum.h"
+#include "trace.h"
 
 #include <chrono>
 #include <thread>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <stdexcept>
 
-NES::NES(Window *window, const std::string &rom_path) :
+NES::NES(Window *window, const std::string &rom_path, std::chrono::milliseconds save_flush_interval) :
     window(window),
     cpu_bus(), ppu_bus(),
     cpu(), cpu_mem(),
     ppu(), palette_mem(),
-    cartridge(rom_path)
+    cartridge(rom_path, save_flush_interval),
+    controller(), io_registers(),
+    cycles{0}, rewind{}, run_ahead{0}, run_ahead_state{},
+    frame{0}, playback{nullptr}, recording{nullptr}, hash_log{nullptr},
+    stats{}, split_frame{false},
+    debugger{}, mid_frame{false},
+    profiler{}, opcode_stats{}, perf_log{},
+    cpu_heatmap{}, ppu_heatmap{}, heatmap_decay{0}
 {
+    cpu_bus.set_logging(false);
+    ppu_bus.set_logging(false);
+
     cpu_bus.map_device(0x0000, 0x1FFF, &cpu_mem);
     cpu_bus.map_device(0x2000, 0x3FFF, ppu.reg_ref());
-    // cpu_bus.map_device(0x4000, 0x4017, APU + IO Registers);
+    cpu_bus.map_device(0x4016, 0x4017, &controller);
+    cpu_bus.map_device(0x4000, 0x401F, &io_registers);
+    cpu_bus.map_device(0x6000, 0x7FFF, cartridge.prg_ram_ref());
     cpu_bus.map_device(0x8000, 0xFFFF, cartridge.prg_ref());
 
     cpu.attach_bus(&cpu_bus);
 
     ppu_bus.map_device(0x0000, 0x1FFF, cartridge.chr_ref());
-    ppu_bus.map_device(0x2000, 0x2FFF, cartridge.vram_ref());
+    ppu_bus.map_device(0x2000, 0x3EFF, cartridge.vram_ref());
     ppu_bus.map_device(0x3F00, 0x3FFF, &palette_mem);
 
     ppu.attach_bus(&ppu_bus);
 }
 
+// Call reset() or restore a state first. Runs until the window is closed, so
+// it needs one; headless callers drive step_frame() themselves.
 void NES::run()
 {
-    constexpr int target_round_period = 601;
+    using clock = std::chrono::steady_clock;
+    using milliseconds = std::chrono::duration<double, std::milli>;
+
+    if (!window)
+    {
+        throw std::runtime_error("NES::run needs a window, use step_frame() headlessly.");
+    }
+
+    TRACE_THREAD_NAME("emulation");
+    uint8_t buttons = 0;
+    clock::time_point frame_start = clock::now();
+    while (window->poll_input(buttons))
+    {
+        TRACE_SCOPE("frame");
+        if (debugger.is_paused())
+        {
+            if (debugger.is_visible()) publish_snapshot();
+            window->draw(ppu.display_ref(), stats, debugger);
+            std::this_thread::sleep_for(std::chrono::milliseconds(16));
+            frame_start = clock::now();
+            continue;
+        }
+
+        if (rewind && !mid_frame && window->rewind_held())
+        {
+            // Going back two frames and emulating one, with the buttons of the
+            // earlier frame, redraws the picture
+            if (rewind_frame() && rewind_frame()) step_frame();
+            window->draw(ppu.display_ref(), stats, debugger);
+            frame_start = clock::now();
+            continue;
+        }
+
+        controller.set_buttons(0, buttons);
+        // Only measured for the overlay, and straight away when it has no figure
+        split_frame = window->stats_visible()
+            && (frame % FrameStats::SPLIT_INTERVAL == 0 || !stats.has_cpu_share());
+        uint64_t start_cycles = cycles;
+        clock::time_point emulate_start = clock::now();
+        step_frame();
+        if (debugger.is_visible()) publish_snapshot();
+        clock::time_point present_start = clock::now();
+        {
+            TRACE_SCOPE("present");
+            window->draw(ppu.display_ref(), stats, debugger);
+        }
+        clock::time_point frame_end = clock::now();
+        if (perf_log && !mid_frame) perf_log->end(frame - 1, "present");
+
+        stats.record(milliseconds(frame_end - frame_start).count(),
+            milliseconds(present_start - emulate_start).count(),
+            milliseconds(frame_end - present_start).count(),
+            cycles - start_cycles);
+        frame_start = frame_end;
+    }
+}
 
+void NES::reset()
+{
     cpu.trigger_rst();
-    for (int i = 0; i < 1e7; ++i)
+    frame = 0;
+}
+
+void NES::run_frame()
+{
+    do
+    {
+        cpu_bus.start_cycle();
+        cpu.clock_cycle();
+        ++cycles;
+
+        for (int j = 0; j < 3; ++j)
+        {
+            ppu_bus.start_cycle();
+            ppu.clock_cycle();
+        }
+    }
+    while (!ppu.frame_complete());
+}
+
+// Advances one displayed frame, applying movie input and logging as set up.
+// Everything here happens once per frame, never per cycle.
+void NES::step_frame()
+{
+    TRACE_SCOPE("emulate");
+    if (perf_log) perf_log->start();
+
+    // When resuming from a breakpoint this frame's input is already applied
+    if (!mid_frame)
+    {
+        if (playback && frame < playback->frame_count())
+        {
+            const Movie::Input &input = playback->frame(frame);
+            controller.set_buttons(0, input[0]);
+            controller.set_buttons(1, input[1]);
+        }
+        else if (recording)
+        {
+            recording->append({controller.get_buttons(0), controller.get_buttons(1)});
+        }
+    }
+
+    // Run-ahead, the debugger and instrumentation take precedence over the
+    // split timing frame, which clears split_frame itself when it runs
+    bool instrumented = false;
+    if (run_ahead > 0)
+    {
+        run_ahead_frame();
+    }
+    else if (debugger.active() || mid_frame)
+    {
+        if (!run_debug_frame()) return;
+    }
+    else if (profiler || opcode_stats || cpu_heatmap)
+    {
+        run_instrumented_frame();
+        instrumented = true;
+    }
+    else if (split_frame)
+    {
+        run_split_frame();
+    }
+    else
+    {
+        run_frame();
+    }
+    if (split_frame)
+    {
+        // Pre-empted, so the overlay shows the CPU/PPU split as unavailable
+        // rather than a figure that has stopped updating
+        split_frame = false;
+        stats.invalidate_cpu_share();
+    }
+    // An instruction left open by an instrumented frame ran on uncounted, so
+    // ending it in a later one would add every cycle in between
+    if (opcode_stats && !instrumented) opcode_stats->abandon();
+
+    if (perf_log) perf_log->end(frame, "emulate");
+    if (cpu_heatmap && heatmap_decay && (frame + 1) % heatmap_decay == 0)
+    {
+        cpu_heatmap->decay();
+        ppu_heatmap->decay();
+    }
+    if (rewind)
+    {
+        TRACE_SCOPE("rewind capture");
+        rewind->capture(*this);
+    }
+    if (hash_log) write_frame_hash();
+    ++frame;
+}
+
+uint64_t NES::get_frame() const
+{
+    return frame;
+}
+
+uint64_t NES::get_cycles() const
+{
+    return cycles;
+}
+
+// Reads through the CPU bus, so I/O registers see the read as the CPU would
+uint8_t NES::read_memory(uint16_t addr)
+{
+    return cpu_bus.get(addr);
+}
+
+Bus *NES::cpu_bus_ref()
+{
+    return &cpu_bus;
+}
+
+const FrameStats *NES::stats_ref() const
+{
+    return &stats;
+}
+
+Debugger *NES::debugger_ref()
+{
+    return &debugger;
+}
+
+// Reads RAM, PRG RAM and PRG ROM for tools straight from the devices,
+// so there are no bus side effects and nothing is counted. I/O registers read as 0.
+uint8_t NES::peek_memory(uint16_t addr)
+{
+    if (addr < 0x2000)
+    {
+        return cpu_mem.get(addr);
+    }
+    if (addr >= 0x8000)
+    {
+        return cartridge.prg_ref()->get(addr - 0x8000);
+    }
+    if (addr >= 0x6000)
+    {
+        return cartridge.prg_ram_ref()->get(addr - 0x6000);
+    }
+    return 0;
+}
+
+uint32_t NES::frame_crc32() const
+{
+    const PPU::Display &display = ppu.display_ref();
+    return crc32(&display[0][0], sizeof(PPU::Display));
+}
+
+// The frame counter is not part of save states; whoever restores one to a
+// known movie position sets it.
+void NES::set_frame(uint64_t frame)
+{
+    this->frame = frame;
+}
+
+// Steps frames until `target_frame` with rendering, run-ahead and hash
+// logging off, except that the last frame is rendered so the display is valid.
+void NES::fast_forward(uint64_t target_frame)
+{
+    std::ostream *log = hash_log;
+    unsigned int ahead = run_ahead;
+    std::unique_ptr<Rewind> history = std::move(rewind);
+    hash_log = nullptr;
+    run_ahead = 0;
+    while (frame < target_frame)
+    {
+        ppu.set_rendering(frame + 1 == target_frame);
+        step_frame();
+    }
+    ppu.set_rendering(true);
+    hash_log = log;
+    run_ahead = ahead;
+    rewind = std::move(history);
+}
+
+// With run-ahead the real frame is emulated without output and snapshotted,
+// the next frames are emulated speculatively with the same input and only
+// the last is rendered, then the snapshot is restored. That hides up to
+// run_ahead frames of the game's own input lag. Only the real frame is
+// instrumented and counted in the heatmaps.
+void NES::run_ahead_frame()
+{
+    ppu.set_rendering(false);
+    if (profiler || opcode_stats || cpu_heatmap)
+    {
+        run_instrumented_frame();
+    }
+    else
+    {
+        run_frame();
+    }
+    save_state(run_ahead_state.data(), run_ahead_state.size());
+    // Saves made in the speculative frames must not reach the battery file
+    cartridge.prg_ram_ref()->set_speculative(true);
+    set_heatmaps_suspended(true);
+    for (unsigned int i = 1; i < run_ahead; ++i)
+    {
+        run_frame();
+    }
+    ppu.set_rendering(true);
+    run_frame();
+    load_state(run_ahead_state.data(), run_ahead_state.size());
+    cartridge.prg_ram_ref()->set_speculative(false);
+    set_heatmaps_suspended(false);
+}
+
+void NES::set_heatmaps_suspended(bool suspended)
+{
+    if (!cpu_heatmap) return;
+    cpu_heatmap->set_suspended(suspended);
+    ppu_heatmap->set_suspended(suspended);
+}
+
+// Same as run_frame, but clocks the CPU and PPU between clock reads to find
+// how emulation time divides between them. The reads make this frame several
+// times slower, which is why it only runs every FrameStats::SPLIT_INTERVAL
+// frames. The cost of a clock read is measured first and taken off both sides.
+void NES::run_split_frame()
+{
+    using clock = std::chrono::steady_clock;
+
+    clock::time_point calibrate_start = clock::now();
+    for (int i = 0; i < 64; ++i)
+    {
+        clock::now();
+    }
+    clock::duration read_cost = (clock::now() - calibrate_start) / 65;
+
+    clock::duration cpu_time{};
+    clock::duration ppu_time{};
+    uint64_t start_cycles = cycles;
+    clock::time_point cpu_start = clock::now();
+    do
+    {
+        cpu_bus.start_cycle();
+        cpu.clock_cycle();
+        ++cycles;
+        clock::time_point ppu_start = clock::now();
+
+        for (int j = 0; j < 3; ++j)
+        {
+            ppu_bus.start_cycle();
+            ppu.clock_cycle();
+        }
+        clock::time_point ppu_end = clock::now();
+
+        cpu_time += ppu_start - cpu_start;
+        ppu_time += ppu_end - ppu_start;
+        cpu_start = ppu_end;
+    }
+    while (!ppu.frame_complete());
+    split_frame = false;
+
+    clock::duration overhead = read_cost * static_cast<clock::rep>(cycles - start_cycles);
+    double cpu = std::max((cpu_time - overhead).count(), clock::rep(0));
+    double ppu = std::max((ppu_time - overhead).count(), clock::rep(0));
+    if (cpu + ppu > 0)
+    {
+        stats.set_cpu_share(cpu / (cpu + ppu));
+    }
+}
+
+// Same as run_frame, with a breakpoint check before every instruction. Returns
+// false when it stops at one; the next call carries on from there. Fetches
+// are counted as in run_instrumented_frame so the heatmaps stay consistent.
+bool NES::run_debug_frame()
+{
+    do
     {
+        if (!cpu.mid_instruction())
+        {
+            uint16_t pc = cpu.get_registers().pc;
+            if (debugger.should_break(pc))
+            {
+                mid_frame = true;
+                return false;
+            }
+            if (cpu_heatmap && !cpu.interrupt_pending()) cpu_heatmap->count(HEAT_FETCH, pc);
+        }
+
         cpu_bus.start_cycle();
         cpu.clock_cycle();
+        ++cycles;
 
         for (int j = 0; j < 3; ++j)
         {
             ppu_bus.start_cycle();
             ppu.clock_cycle();
-            if (ppu.frame_complete() && j == 0 && i%30000 == 0)
+        }
+    }
+    while (!ppu.frame_complete());
+    mid_frame = false;
+    return true;
+}
+
+// Same as run_frame, reporting instruction starts and cycles to the profiler,
+// opcode counters and heatmap, whichever are enabled
+void NES::run_instrumented_frame()
+{
+    uint16_t pc = cpu.get_registers().pc;
+    do
+    {
+        bool starting = !cpu.mid_instruction();
+        bool interrupting = false;
+        if (starting)
+        {
+            pc = cpu.get_registers().pc;
+            interrupting = cpu.interrupt_pending();
+            if (opcode_stats) opcode_stats->end(cycles);
+            if (cpu_heatmap && !interrupting) cpu_heatmap->count(HEAT_FETCH, pc);
+        }
+
+        cpu_bus.start_cycle();
+        cpu.clock_cycle();
+        ++cycles;
+        if (starting)
+        {
+            if (profiler) profiler->instruction(pc, cpu.get_opcode());
+            if (opcode_stats && interrupting)
             {
-                window->draw(ppu.get_display());
+                opcode_stats->begin_interrupt(cpu.get_interrupt_vector(), cycles - 1);
+            }
+            else if (opcode_stats)
+            {
+                opcode_stats->begin(cpu.get_opcode(), cycles - 1);
             }
         }
+        if (profiler) profiler->clock(pc);
+
+        for (int j = 0; j < 3; ++j)
+        {
+            ppu_bus.start_cycle();
+            ppu.clock_cycle();
+        }
     }
+    while (!ppu.frame_complete());
+}
+
+// Copies the pages marked in dirty from src into the first size bytes of dst
+// and clears the marks. With tracking off that is a full copy every time.
+static void copy_dirty(DirtyMap &dirty, const uint8_t *src, uint8_t *dst, std::size_t size)
+{
+    std::size_t page_size = dirty.page_size();
+    dirty.for_each([&](std::size_t page)
+    {
+        std::size_t start = page * page_size;
+        if (start >= size) return;
+        std::size_t length = std::min(size - start, page_size);
+        std::copy_n(src + start, length, dst + start);
+    });
+    dirty.clear();
+}
+
+// The snapshot is the consumer of the CPU RAM, VRAM, OAM and palette dirty
+// maps, so it only copies pages written since the last one was published
+void NES::publish_snapshot()
+{
+    DebugSnapshot &snapshot = *debugger.snapshot_ref();
+    snapshot.frame = frame;
+    snapshot.cycles = cycles;
+    snapshot.registers = cpu.get_registers();
+    copy_dirty(*cpu_mem.dirty_ref(), cpu_mem.data(), snapshot.cpu_mem.data(), snapshot.cpu_mem.size());
+    copy_dirty(*vram_dirty_ref(), cartridge.vram_data().data(), snapshot.vram.data(), snapshot.vram.size());
+    copy_dirty(*ppu.oam_dirty_ref(), ppu.oam_ref()->data(), snapshot.oam.data(), snapshot.oam.size());
+    copy_dirty(*palette_mem.dirty_ref(), palette_mem.data(), snapshot.palette.data(), snapshot.palette.size());
+
+    snapshot.code_start = snapshot.registers.pc - DebugSnapshot::CODE_BEFORE_PC;
+    for (std::size_t i = 0; i < snapshot.code.size(); ++i)
+    {
+        snapshot.code[i] = peek_memory(snapshot.code_start + i);
+    }
+}
+
+void NES::set_input(int port, uint8_t buttons)
+{
+    controller.set_buttons(port, buttons);
+}
+
+void NES::set_run_ahead(unsigned int frames)
+{
+    run_ahead = frames;
+    run_ahead_state.resize(frames ? state_size() : 0);
+}
+
+// Movies start from power-on, so call these before reset().
+// Battery RAM is not cleared and is part of the starting conditions.
+void NES::play_movie(const Movie *movie)
+{
+    playback = movie;
+    recording = nullptr;
+    frame = 0;
+    if (movie->get_rom_crc() != 0 && movie->get_rom_crc() != rom_crc32())
+    {
+        std::cerr << "Movie was recorded with a different ROM" << std::endl;
+    }
+}
+
+void NES::record_movie(Movie *movie)
+{
+    recording = movie;
+    playback = nullptr;
+    frame = 0;
+    movie->set_rom_crc(rom_crc32());
+}
+
+bool NES::movie_finished() const
+{
+    return playback && frame >= playback->frame_count();
+}
+
+// One line per frame: frame, framebuffer CRC32, CPU RAM CRC32. Two runs
+// diverge at the first line that differs.
+void NES::set_hash_log(std::ostream *log)
+{
+    hash_log = log;
+}
+
+uint32_t NES::rom_crc32() const
+{
+    return cartridge.rom_crc32();
+}
+
+uint32_t NES::save_ram_crc32() const
+{
+    return cartridge.save_ram_crc32();
+}
+
+void NES::write_frame_hash()
+{
+    uint32_t display_crc = frame_crc32();
+    uint32_t ram_crc = crc32(cpu_mem.data(), 1<<11);
+    *hash_log << std::dec << frame << ' ' << std::hex << std::setfill('0')
+        << std::setw(8) << display_crc << ' ' << std::setw(8) << ram_crc << '\n';
+}
+
+// Keeps the state after each completed frame in a ring of capacity bytes,
+// see Rewind
+void NES::enable_rewind(std::size_t capacity, unsigned int keyframe_interval)
+{
+    rewind = std::make_unique<Rewind>(state_size(), capacity, keyframe_interval);
+}
+
+// Restores the state one frame back, if it is still in the ring. The frame
+// counter follows, and a movie being recorded loses the undone frames.
+bool NES::rewind_frame()
+{
+    if (!rewind || frame == 0 || !rewind->restore_previous(*this))
+    {
+        return false;
+    }
+    --frame;
+    if (recording) recording->truncate(frame);
+    return true;
+}
+
+// Frames are profiled from here on, see Profiler. Run-ahead frames are not.
+void NES::enable_profiler(unsigned int interval)
+{
+    profiler = std::make_unique<Profiler>(cartridge.mapper_ref(), interval);
+}
+
+const Profiler *NES::profiler_ref() const
+{
+    return profiler.get();
+}
+
+// Counts from here on, see OpcodeStats. Run-ahead frames are not counted.
+void NES::enable_opcode_stats()
+{
+    opcode_stats = std::make_unique<OpcodeStats>();
+}
+
+const OpcodeStats *NES::opcode_stats_ref() const
+{
+    return opcode_stats.get();
+}
+
+// Counts reads and writes on both buses, and opcode fetches, per address
+void NES::enable_heatmaps(unsigned int decay_interval)
+{
+    cpu_heatmap = std::make_unique<AccessHeatmap>(1<<16);
+    ppu_heatmap = std::make_unique<AccessHeatmap>(1<<14);
+    heatmap_decay = decay_interval;
+    cpu_bus.set_heatmap(cpu_heatmap.get());
+    ppu_bus.set_heatmap(ppu_heatmap.get());
+    debugger.set_heatmaps(cpu_heatmap.get(), ppu_heatmap.get());
+}
+
+const AccessHeatmap *NES::cpu_heatmap_ref() const
+{
+    return cpu_heatmap.get();
+}
+
+const AccessHeatmap *NES::ppu_heatmap_ref() const
+{
+    return ppu_heatmap.get();
+}
+
+// Page bitmaps of the writable memories, see DirtyPages. Each has a single
+// consumer that clears it; while the debugger is visible, publish_snapshot()
+// consumes CPU RAM, VRAM, OAM and palette. VRAM and CHR-RAM pages are
+// offsets into the RAM itself, not PPU addresses.
+DirtyMap *NES::cpu_mem_dirty_ref()
+{
+    return cpu_mem.dirty_ref();
+}
+
+DirtyMap *NES::vram_dirty_ref()
+{
+    return cartridge.vram_ref()->dirty_ref();
+}
+
+DirtyMap *NES::oam_dirty_ref()
+{
+    return ppu.oam_dirty_ref();
+}
+
+DirtyMap *NES::palette_dirty_ref()
+{
+    return palette_mem.dirty_ref();
+}
+
+DirtyMap *NES::chr_ram_dirty_ref()
+{
+    return cartridge.chr_ref()->dirty_ref();
+}
+
+DirtyMap *NES::prg_ram_dirty_ref()
+{
+    return cartridge.prg_ram_ref()->dirty_ref();
+}
+
+// Logs hardware counters for each frame's emulation and, under run(), its
+// presentation as CSV. Returns false, leaving logging off, when the counters
+// cannot be opened.
+bool NES::set_perf_log(std::ostream *log)
+{
+    perf_log.reset();
+    if (log)
+    {
+        perf_log = std::make_unique<PerfLog>(*log);
+        if (!perf_log->available()) perf_log.reset();
+    }
+    return perf_log != nullptr;
+}
+
+std::size_t NES::state_size() const
+{
+    StateWriter counter(nullptr, 0);
+    counter.write(STATE_MAGIC);
+    counter.write(STATE_VERSION);
+    save_components(counter);
+    return counter.size();
+}
+
+std::size_t NES::save_state(uint8_t *buffer, std::size_t capacity) const
+{
+    StateWriter writer(buffer, capacity);
+    writer.write(STATE_MAGIC);
+    writer.write(STATE_VERSION);
+    save_components(writer);
+    return writer.size();
+}
+
+void NES::load_state(const uint8_t *buffer, std::size_t size)
+{
+    StateReader reader(buffer, size);
+    uint32_t magic;
+    uint16_t version;
+    reader.read(magic);
+    reader.read(version);
+    if (magic != STATE_MAGIC || version != STATE_VERSION)
+    {
+        throw std::runtime_error("Save state has an unsupported format.");
+    }
+    // Reject before touching anything so a bad state cannot leave us half-loaded
+    if (size != state_size())
+    {
+        throw std::runtime_error("Save state does not match this cartridge.");
+    }
+
+    cpu.load_state(reader);
+    cpu_mem.load_state(reader);
+    ppu.load_state(reader);
+    palette_mem.load_state(reader);
+    cartridge.load_state(reader);
+    controller.load_state(reader);
+    io_registers.load_state(reader);
+    if (opcode_stats) opcode_stats->abandon();
+}
+
+void NES::save_components(StateWriter &writer) const
+{
+    cpu.save_state(writer);
+    cpu_mem.save_state(writer);
+    ppu.save_state(writer);
+    palette_mem.save_state(writer);
+    cartridge.save_state(writer);
+    controller.save_state(writer);
+    io_registers.save_state(writer);
 }
\ No newline at end of file
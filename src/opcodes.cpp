@@ -0,0 +1,251 @@
+#include "opcodes.h"
+
+#include <array>
+
+#include <cstdio>
+
+struct OpcodeDefinition
+{
+    uint8_t opcode;
+    OpcodeInfo info;
+};
+
+// Official 6502 opcodes
+static constexpr OpcodeDefinition definitions[] = {
+    {0x00, {"BRK", AddressingMode::IMPLIED, 7}},
+    {0x01, {"ORA", AddressingMode::INDEXED_INDIRECT, 6}},
+    {0x05, {"ORA", AddressingMode::ZERO_PAGE, 3}},
+    {0x06, {"ASL", AddressingMode::ZERO_PAGE, 5}},
+    {0x08, {"PHP", AddressingMode::IMPLIED, 3}},
+    {0x09, {"ORA", AddressingMode::IMMEDIATE, 2}},
+    {0x0A, {"ASL", AddressingMode::ACCUMULATOR, 2}},
+    {0x0D, {"ORA", AddressingMode::ABSOLUTE, 4}},
+    {0x0E, {"ASL", AddressingMode::ABSOLUTE, 6}},
+    {0x10, {"BPL", AddressingMode::RELATIVE, 2}},
+    {0x11, {"ORA", AddressingMode::INDIRECT_INDEXED, 5}},
+    {0x15, {"ORA", AddressingMode::ZERO_PAGE_X, 4}},
+    {0x16, {"ASL", AddressingMode::ZERO_PAGE_X, 6}},
+    {0x18, {"CLC", AddressingMode::IMPLIED, 2}},
+    {0x19, {"ORA", AddressingMode::ABSOLUTE_Y, 4}},
+    {0x1D, {"ORA", AddressingMode::ABSOLUTE_X, 4}},
+    {0x1E, {"ASL", AddressingMode::ABSOLUTE_X, 7}},
+    {0x20, {"JSR", AddressingMode::ABSOLUTE, 6}},
+    {0x21, {"AND", AddressingMode::INDEXED_INDIRECT, 6}},
+    {0x24, {"BIT", AddressingMode::ZERO_PAGE, 3}},
+    {0x25, {"AND", AddressingMode::ZERO_PAGE, 3}},
+    {0x26, {"ROL", AddressingMode::ZERO_PAGE, 5}},
+    {0x28, {"PLP", AddressingMode::IMPLIED, 4}},
+    {0x29, {"AND", AddressingMode::IMMEDIATE, 2}},
+    {0x2A, {"ROL", AddressingMode::ACCUMULATOR, 2}},
+    {0x2C, {"BIT", AddressingMode::ABSOLUTE, 4}},
+    {0x2D, {"AND", AddressingMode::ABSOLUTE, 4}},
+    {0x2E, {"ROL", AddressingMode::ABSOLUTE, 6}},
+    {0x30, {"BMI", AddressingMode::RELATIVE, 2}},
+    {0x31, {"AND", AddressingMode::INDIRECT_INDEXED, 5}},
+    {0x35, {"AND", AddressingMode::ZERO_PAGE_X, 4}},
+    {0x36, {"ROL", AddressingMode::ZERO_PAGE_X, 6}},
+    {0x38, {"SEC", AddressingMode::IMPLIED, 2}},
+    {0x39, {"AND", AddressingMode::ABSOLUTE_Y, 4}},
+    {0x3D, {"AND", AddressingMode::ABSOLUTE_X, 4}},
+    {0x3E, {"ROL", AddressingMode::ABSOLUTE_X, 7}},
+    {0x40, {"RTI", AddressingMode::IMPLIED, 6}},
+    {0x41, {"EOR", AddressingMode::INDEXED_INDIRECT, 6}},
+    {0x45, {"EOR", AddressingMode::ZERO_PAGE, 3}},
+    {0x46, {"LSR", AddressingMode::ZERO_PAGE, 5}},
+    {0x48, {"PHA", AddressingMode::IMPLIED, 3}},
+    {0x49, {"EOR", AddressingMode::IMMEDIATE, 2}},
+    {0x4A, {"LSR", AddressingMode::ACCUMULATOR, 2}},
+    {0x4C, {"JMP", AddressingMode::ABSOLUTE, 3}},
+    {0x4D, {"EOR", AddressingMode::ABSOLUTE, 4}},
+    {0x4E, {"LSR", AddressingMode::ABSOLUTE, 6}},
+    {0x50, {"BVC", AddressingMode::RELATIVE, 2}},
+    {0x51, {"EOR", AddressingMode::INDIRECT_INDEXED, 5}},
+    {0x55, {"EOR", AddressingMode::ZERO_PAGE_X, 4}},
+    {0x56, {"LSR", AddressingMode::ZERO_PAGE_X, 6}},
+    {0x58, {"CLI", AddressingMode::IMPLIED, 2}},
+    {0x59, {"EOR", AddressingMode::ABSOLUTE_Y, 4}},
+    {0x5D, {"EOR", AddressingMode::ABSOLUTE_X, 4}},
+    {0x5E, {"LSR", AddressingMode::ABSOLUTE_X, 7}},
+    {0x60, {"RTS", AddressingMode::IMPLIED, 6}},
+    {0x61, {"ADC", AddressingMode::INDEXED_INDIRECT, 6}},
+    {0x65, {"ADC", AddressingMode::ZERO_PAGE, 3}},
+    {0x66, {"ROR", AddressingMode::ZERO_PAGE, 5}},
+    {0x68, {"PLA", AddressingMode::IMPLIED, 4}},
+    {0x69, {"ADC", AddressingMode::IMMEDIATE, 2}},
+    {0x6A, {"ROR", AddressingMode::ACCUMULATOR, 2}},
+    {0x6C, {"JMP", AddressingMode::INDIRECT, 5}},
+    {0x6D, {"ADC", AddressingMode::ABSOLUTE, 4}},
+    {0x6E, {"ROR", AddressingMode::ABSOLUTE, 6}},
+    {0x70, {"BVS", AddressingMode::RELATIVE, 2}},
+    {0x71, {"ADC", AddressingMode::INDIRECT_INDEXED, 5}},
+    {0x75, {"ADC", AddressingMode::ZERO_PAGE_X, 4}},
+    {0x76, {"ROR", AddressingMode::ZERO_PAGE_X, 6}},
+    {0x78, {"SEI", AddressingMode::IMPLIED, 2}},
+    {0x79, {"ADC", AddressingMode::ABSOLUTE_Y, 4}},
+    {0x7D, {"ADC", AddressingMode::ABSOLUTE_X, 4}},
+    {0x7E, {"ROR", AddressingMode::ABSOLUTE_X, 7}},
+    {0x81, {"STA", AddressingMode::INDEXED_INDIRECT, 6}},
+    {0x84, {"STY", AddressingMode::ZERO_PAGE, 3}},
+    {0x85, {"STA", AddressingMode::ZERO_PAGE, 3}},
+    {0x86, {"STX", AddressingMode::ZERO_PAGE, 3}},
+    {0x88, {"DEY", AddressingMode::IMPLIED, 2}},
+    {0x8A, {"TXA", AddressingMode::IMPLIED, 2}},
+    {0x8C, {"STY", AddressingMode::ABSOLUTE, 4}},
+    {0x8D, {"STA", AddressingMode::ABSOLUTE, 4}},
+    {0x8E, {"STX", AddressingMode::ABSOLUTE, 4}},
+    {0x90, {"BCC", AddressingMode::RELATIVE, 2}},
+    {0x91, {"STA", AddressingMode::INDIRECT_INDEXED, 6}},
+    {0x94, {"STY", AddressingMode::ZERO_PAGE_X, 4}},
+    {0x95, {"STA", AddressingMode::ZERO_PAGE_X, 4}},
+    {0x96, {"STX", AddressingMode::ZERO_PAGE_Y, 4}},
+    {0x98, {"TYA", AddressingMode::IMPLIED, 2}},
+    {0x99, {"STA", AddressingMode::ABSOLUTE_Y, 5}},
+    {0x9A, {"TXS", AddressingMode::IMPLIED, 2}},
+    {0x9D, {"STA", AddressingMode::ABSOLUTE_X, 5}},
+    {0xA0, {"LDY", AddressingMode::IMMEDIATE, 2}},
+    {0xA1, {"LDA", AddressingMode::INDEXED_INDIRECT, 6}},
+    {0xA2, {"LDX", AddressingMode::IMMEDIATE, 2}},
+    {0xA4, {"LDY", AddressingMode::ZERO_PAGE, 3}},
+    {0xA5, {"LDA", AddressingMode::ZERO_PAGE, 3}},
+    {0xA6, {"LDX", AddressingMode::ZERO_PAGE, 3}},
+    {0xA8, {"TAY", AddressingMode::IMPLIED, 2}},
+    {0xA9, {"LDA", AddressingMode::IMMEDIATE, 2}},
+    {0xAA, {"TAX", AddressingMode::IMPLIED, 2}},
+    {0xAC, {"LDY", AddressingMode::ABSOLUTE, 4}},
+    {0xAD, {"LDA", AddressingMode::ABSOLUTE, 4}},
+    {0xAE, {"LDX", AddressingMode::ABSOLUTE, 4}},
+    {0xB0, {"BCS", AddressingMode::RELATIVE, 2}},
+    {0xB1, {"LDA", AddressingMode::INDIRECT_INDEXED, 5}},
+    {0xB4, {"LDY", AddressingMode::ZERO_PAGE_X, 4}},
+    {0xB5, {"LDA", AddressingMode::ZERO_PAGE_X, 4}},
+    {0xB6, {"LDX", AddressingMode::ZERO_PAGE_Y, 4}},
+    {0xB8, {"CLV", AddressingMode::IMPLIED, 2}},
+    {0xB9, {"LDA", AddressingMode::ABSOLUTE_Y, 4}},
+    {0xBA, {"TSX", AddressingMode::IMPLIED, 2}},
+    {0xBC, {"LDY", AddressingMode::ABSOLUTE_X, 4}},
+    {0xBD, {"LDA", AddressingMode::ABSOLUTE_X, 4}},
+    {0xBE, {"LDX", AddressingMode::ABSOLUTE_Y, 4}},
+    {0xC0, {"CPY", AddressingMode::IMMEDIATE, 2}},
+    {0xC1, {"CMP", AddressingMode::INDEXED_INDIRECT, 6}},
+    {0xC4, {"CPY", AddressingMode::ZERO_PAGE, 3}},
+    {0xC5, {"CMP", AddressingMode::ZERO_PAGE, 3}},
+    {0xC6, {"DEC", AddressingMode::ZERO_PAGE, 5}},
+    {0xC8, {"INY", AddressingMode::IMPLIED, 2}},
+    {0xC9, {"CMP", AddressingMode::IMMEDIATE, 2}},
+    {0xCA, {"DEX", AddressingMode::IMPLIED, 2}},
+    {0xCC, {"CPY", AddressingMode::ABSOLUTE, 4}},
+    {0xCD, {"CMP", AddressingMode::ABSOLUTE, 4}},
+    {0xCE, {"DEC", AddressingMode::ABSOLUTE, 6}},
+    {0xD0, {"BNE", AddressingMode::RELATIVE, 2}},
+    {0xD1, {"CMP", AddressingMode::INDIRECT_INDEXED, 5}},
+    {0xD5, {"CMP", AddressingMode::ZERO_PAGE_X, 4}},
+    {0xD6, {"DEC", AddressingMode::ZERO_PAGE_X, 6}},
+    {0xD8, {"CLD", AddressingMode::IMPLIED, 2}},
+    {0xD9, {"CMP", AddressingMode::ABSOLUTE_Y, 4}},
+    {0xDD, {"CMP", AddressingMode::ABSOLUTE_X, 4}},
+    {0xDE, {"DEC", AddressingMode::ABSOLUTE_X, 7}},
+    {0xE0, {"CPX", AddressingMode::IMMEDIATE, 2}},
+    {0xE1, {"SBC", AddressingMode::INDEXED_INDIRECT, 6}},
+    {0xE4, {"CPX", AddressingMode::ZERO_PAGE, 3}},
+    {0xE5, {"SBC", AddressingMode::ZERO_PAGE, 3}},
+    {0xE6, {"INC", AddressingMode::ZERO_PAGE, 5}},
+    {0xE8, {"INX", AddressingMode::IMPLIED, 2}},
+    {0xE9, {"SBC", AddressingMode::IMMEDIATE, 2}},
+    {0xEA, {"NOP", AddressingMode::IMPLIED, 2}},
+    {0xEC, {"CPX", AddressingMode::ABSOLUTE, 4}},
+    {0xED, {"SBC", AddressingMode::ABSOLUTE, 4}},
+    {0xEE, {"INC", AddressingMode::ABSOLUTE, 6}},
+    {0xF0, {"BEQ", AddressingMode::RELATIVE, 2}},
+    {0xF1, {"SBC", AddressingMode::INDIRECT_INDEXED, 5}},
+    {0xF5, {"SBC", AddressingMode::ZERO_PAGE_X, 4}},
+    {0xF6, {"INC", AddressingMode::ZERO_PAGE_X, 6}},
+    {0xF8, {"SED", AddressingMode::IMPLIED, 2}},
+    {0xF9, {"SBC", AddressingMode::ABSOLUTE_Y, 4}},
+    {0xFD, {"SBC", AddressingMode::ABSOLUTE_X, 4}},
+    {0xFE, {"INC", AddressingMode::ABSOLUTE_X, 7}},
+};
+
+static constexpr std::array<OpcodeInfo, 256> build_table()
+{
+    std::array<OpcodeInfo, 256> table{};
+    for (const OpcodeDefinition &definition : definitions)
+    {
+        table[definition.opcode] = definition.info;
+    }
+    return table;
+}
+
+static constexpr std::array<OpcodeInfo, 256> opcode_table = build_table();
+
+const OpcodeInfo &opcode_info(uint8_t opcode)
+{
+    return opcode_table[opcode];
+}
+
+const char *addressing_mode_name(AddressingMode mode)
+{
+    static constexpr const char *names[] = {
+        "implied", "accumulator", "immediate", "zero page", "zero page,X", "zero page,Y",
+        "relative", "absolute", "absolute,X", "absolute,Y", "indirect", "(indirect,X)", "(indirect),Y"
+    };
+    return names[mode];
+}
+
+unsigned int instruction_length(AddressingMode mode)
+{
+    switch (mode)
+    {
+    case AddressingMode::IMPLIED:
+    case AddressingMode::ACCUMULATOR:
+        return 1;
+    case AddressingMode::ABSOLUTE:
+    case AddressingMode::ABSOLUTE_X:
+    case AddressingMode::ABSOLUTE_Y:
+    case AddressingMode::INDIRECT:
+        return 3;
+    default:
+        return 2;
+    }
+}
+
+// Formats the instruction at `addr`, whose bytes start at `bytes`, in the
+// usual assembler syntax. Unofficial opcodes come out as a .db directive.
+std::string disassemble(uint16_t addr, const uint8_t *bytes)
+{
+    const OpcodeInfo &info = opcode_info(bytes[0]);
+    if (!info.mnemonic)
+    {
+        char text[16];
+        std::snprintf(text, sizeof(text), ".db $%02X", bytes[0]);
+        return text;
+    }
+
+    unsigned int operand = bytes[1];
+    if (instruction_length(info.mode) == 3)
+    {
+        operand |= bytes[2] << 8;
+    }
+
+    char text[32];
+    const char *m = info.mnemonic;
+    switch (info.mode)
+    {
+    case AddressingMode::IMPLIED: std::snprintf(text, sizeof(text), "%s", m); break;
+    case AddressingMode::ACCUMULATOR: std::snprintf(text, sizeof(text), "%s A", m); break;
+    case AddressingMode::IMMEDIATE: std::snprintf(text, sizeof(text), "%s #$%02X", m, operand); break;
+    case AddressingMode::ZERO_PAGE: std::snprintf(text, sizeof(text), "%s $%02X", m, operand); break;
+    case AddressingMode::ZERO_PAGE_X: std::snprintf(text, sizeof(text), "%s $%02X,X", m, operand); break;
+    case AddressingMode::ZERO_PAGE_Y: std::snprintf(text, sizeof(text), "%s $%02X,Y", m, operand); break;
+    case AddressingMode::RELATIVE:
+        std::snprintf(text, sizeof(text), "%s $%04X", m, (addr + 2 + static_cast<int8_t>(operand)) & 0xFFFF);
+        break;
+    case AddressingMode::ABSOLUTE: std::snprintf(text, sizeof(text), "%s $%04X", m, operand); break;
+    case AddressingMode::ABSOLUTE_X: std::snprintf(text, sizeof(text), "%s $%04X,X", m, operand); break;
+    case AddressingMode::ABSOLUTE_Y: std::snprintf(text, sizeof(text), "%s $%04X,Y", m, operand); break;
+    case AddressingMode::INDIRECT: std::snprintf(text, sizeof(text), "%s ($%04X)", m, operand); break;
+    case AddressingMode::INDEXED_INDIRECT: std::snprintf(text, sizeof(text), "%s ($%02X,X)", m, operand); break;
+    case AddressingMode::INDIRECT_INDEXED: std::snprintf(text, sizeof(text), "%s ($%02X),Y", m, operand); break;
+    default: std::snprintf(text, sizeof(text), "%s", m); break;
+    }
+    return text;
+}
@@ -0,0 +1,183 @@
+#include "opcodestats.h"
+#include "opcodes.h"
+
+#include <algorithm>
+#include <vector>
+#include <iomanip>
+
+#include <cstdio>
+
+OpcodeStats::OpcodeStats() :
+    opcodes{}, interrupts{}, interrupt_cycles{0},
+    open{false}, open_interrupt{false}, open_opcode{0}, open_cycle{0}
+{}
+
+// Call at the first cycle of each instruction, before ending the previous one
+void OpcodeStats::begin(uint8_t opcode, uint64_t cycle)
+{
+    open = true;
+    open_interrupt = false;
+    open_opcode = opcode;
+    open_cycle = cycle;
+}
+
+void OpcodeStats::begin_interrupt(uint16_t vector, uint64_t cycle)
+{
+    switch (vector)
+    {
+    case 0xFFFC: ++interrupts[INTERRUPT_RESET]; break;
+    case 0xFFFA: ++interrupts[INTERRUPT_NMI]; break;
+    default: ++interrupts[INTERRUPT_IRQ]; break;
+    }
+    open = true;
+    open_interrupt = true;
+    open_cycle = cycle;
+}
+
+void OpcodeStats::end(uint64_t cycle)
+{
+    if (!open) return;
+    open = false;
+
+    uint64_t length = cycle - open_cycle;
+    if (open_interrupt)
+    {
+        interrupt_cycles += length;
+        return;
+    }
+
+    OpcodeCounters &counters = opcodes[open_opcode];
+    ++counters.executions;
+    counters.cycles += length;
+
+    const OpcodeInfo &info = opcode_info(open_opcode);
+    if (!info.mnemonic) return;
+
+    uint64_t extra = length > info.cycles ? length - info.cycles : 0;
+    bool explained = length >= info.cycles;
+    switch (info.mode)
+    {
+    case AddressingMode::RELATIVE:
+        if (length == info.cycles)
+        {
+            ++counters.branches_not_taken;
+        }
+        else
+        {
+            // One cycle for taking the branch, one more if it crosses a page
+            ++counters.branches_taken;
+            counters.page_cross_cycles += extra - 1;
+            explained = explained && extra <= 2;
+        }
+        break;
+    case AddressingMode::ABSOLUTE_X:
+    case AddressingMode::ABSOLUTE_Y:
+    case AddressingMode::INDIRECT_INDEXED:
+        counters.page_cross_cycles += extra;
+        explained = explained && extra <= 1;
+        break;
+    default:
+        explained = explained && extra == 0;
+        break;
+    }
+    if (!explained)
+    {
+        ++counters.unexpected;
+    }
+}
+
+// Drops the open instruction without counting it, for when it runs on
+// unobserved or the machine state is replaced under it
+void OpcodeStats::abandon()
+{
+    open = false;
+}
+
+const OpcodeCounters &OpcodeStats::counters(uint8_t opcode) const
+{
+    return opcodes[opcode];
+}
+
+uint64_t OpcodeStats::interrupt_count(InterruptType type) const
+{
+    return interrupts[type];
+}
+
+// Executed opcodes only, most cycles first
+nlohmann::json OpcodeStats::to_json() const
+{
+    std::vector<int> executed;
+    for (int op = 0; op < 256; ++op)
+    {
+        if (opcodes[op].executions) executed.push_back(op);
+    }
+    std::sort(executed.begin(), executed.end(), [this](int a, int b)
+    {
+        return opcodes[a].cycles > opcodes[b].cycles;
+    });
+
+    nlohmann::json report;
+    report["interrupts"] = {
+        {"reset", interrupts[INTERRUPT_RESET]},
+        {"nmi", interrupts[INTERRUPT_NMI]},
+        {"irq", interrupts[INTERRUPT_IRQ]},
+        {"cycles", interrupt_cycles}
+    };
+    report["opcodes"] = nlohmann::json::array();
+    for (int op : executed)
+    {
+        const OpcodeCounters &c = opcodes[op];
+        const OpcodeInfo &info = opcode_info(op);
+        char hex[8];
+        std::snprintf(hex, sizeof(hex), "0x%02X", op);
+        report["opcodes"].push_back({
+            {"opcode", hex},
+            {"mnemonic", info.mnemonic ? info.mnemonic : "???"},
+            {"mode", addressing_mode_name(info.mode)},
+            {"executions", c.executions},
+            {"cycles", c.cycles},
+            {"base_cycles", info.cycles},
+            {"page_cross_cycles", c.page_cross_cycles},
+            {"branches_taken", c.branches_taken},
+            {"branches_not_taken", c.branches_not_taken},
+            {"unexpected", c.unexpected}
+        });
+    }
+    return report;
+}
+
+void OpcodeStats::write_report(std::ostream &out) const
+{
+    nlohmann::json report = to_json();
+    uint64_t total = report["interrupts"]["cycles"].get<uint64_t>();
+    for (const auto &entry : report["opcodes"])
+    {
+        total += entry["cycles"].get<uint64_t>();
+    }
+
+    out << "Interrupts: " << interrupts[INTERRUPT_RESET] << " reset, " << interrupts[INTERRUPT_NMI]
+        << " NMI, " << interrupts[INTERRUPT_IRQ] << " IRQ\n";
+    out << "op    instr  mode           executions          cycles  cycles%  page-x  taken%  unexpected\n";
+    out << std::fixed << std::setprecision(1);
+    for (const auto &entry : report["opcodes"])
+    {
+        uint64_t taken = entry["branches_taken"].get<uint64_t>();
+        uint64_t branches = taken + entry["branches_not_taken"].get<uint64_t>();
+        out << std::left << std::setw(6) << entry["opcode"].get<std::string>().substr(2)
+            << std::setw(7) << entry["mnemonic"].get<std::string>()
+            << std::setw(13) << entry["mode"].get<std::string>() << std::right
+            << std::setw(12) << entry["executions"].get<uint64_t>()
+            << std::setw(16) << entry["cycles"].get<uint64_t>()
+            << std::setw(9) << (total ? 100.0 * entry["cycles"].get<uint64_t>() / total : 0.0)
+            << std::setw(8) << entry["page_cross_cycles"].get<uint64_t>();
+        if (branches)
+        {
+            out << std::setw(8) << 100.0 * taken / branches;
+        }
+        else
+        {
+            out << std::setw(8) << '-';
+        }
+        out << std::setw(12) << entry["unexpected"].get<uint64_t>() << '\n';
+    }
+}
@@ -0,0 +1,177 @@
+#include "perfcounters.h"
+
+#include <iostream>
+#include <cstring>
+#include <cmath>
+#include <string>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static int open_counter(uint32_t type, uint64_t config, int group)
+{
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = group < 0; // The leader starts the whole group
+    attr.exclude_kernel = 1; // Allowed at the default perf_event_paranoid level
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group, 0));
+}
+
+static constexpr uint64_t cache_config(uint64_t cache, uint64_t op, uint64_t result)
+{
+    return cache | (op << 8) | (result << 16);
+}
+
+PerfCounters::PerfCounters() :
+    fds{}, slots{}, leader{-1}, opened{0}
+{
+    static const std::array<std::pair<uint32_t, uint64_t>, COUNTER_COUNT> events = {{
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        {PERF_TYPE_HW_CACHE, cache_config(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES}
+    }};
+
+    for (std::size_t i = 0; i < COUNTER_COUNT; ++i)
+    {
+        fds[i] = open_counter(events[i].first, events[i].second, leader);
+        slots[i] = -1;
+        if (fds[i] < 0) continue;
+        if (leader < 0) leader = fds[i];
+        slots[i] = static_cast<int>(opened++);
+    }
+
+    if (leader >= 0)
+    {
+        ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+}
+
+PerfCounters::~PerfCounters()
+{
+    for (int fd : fds)
+    {
+        if (fd >= 0) close(fd);
+    }
+}
+
+bool PerfCounters::available() const
+{
+    return opened > 0;
+}
+
+bool PerfCounters::has(Counter counter) const
+{
+    return slots[counter] >= 0;
+}
+
+// Totals since the counters were opened, unscaled
+PerfCounters::Reading PerfCounters::read() const
+{
+    Reading reading{};
+    if (!available()) return reading;
+
+    // nr, time enabled, time running, then values in open order
+    std::array<uint64_t, COUNTER_COUNT + 3> buffer{};
+    if (::read(leader, buffer.data(), sizeof(buffer)) <= 0) return reading;
+    reading.time_enabled = buffer[1];
+    reading.time_running = buffer[2];
+    for (std::size_t i = 0; i < COUNTER_COUNT; ++i)
+    {
+        if (slots[i] >= 0) reading.values[i] = buffer[3 + slots[i]];
+    }
+    return reading;
+}
+
+const char *PerfCounters::name(Counter counter)
+{
+    static constexpr const char *names[] = {
+        "cycles", "instructions", "branch_misses", "l1d_misses", "llc_misses"
+    };
+    return names[counter];
+}
+
+PerfLog::PerfLog(std::ostream &out) :
+    counters(), out(out), phase_start{}
+{
+    if (!counters.available())
+    {
+        std::cerr << "Hardware performance counters are not available, perf log disabled" << std::endl;
+        return;
+    }
+    out << "frame,phase";
+    for (std::size_t i = 0; i < PerfCounters::COUNTER_COUNT; ++i)
+    {
+        out << ',' << PerfCounters::name(static_cast<PerfCounters::Counter>(i));
+    }
+    out << ",ipc,branch_mpki,l1d_mpki,llc_mpki,running\n";
+}
+
+bool PerfLog::available() const
+{
+    return counters.available();
+}
+
+void PerfLog::start()
+{
+    phase_start = counters.read();
+}
+
+void PerfLog::end(uint64_t frame, const char *phase)
+{
+    PerfCounters::Reading now = counters.read();
+    uint64_t enabled = now.time_enabled - phase_start.time_enabled;
+    uint64_t running = now.time_running - phase_start.time_running;
+    PerfCounters::Values delta;
+    for (std::size_t i = 0; i < PerfCounters::COUNTER_COUNT; ++i)
+    {
+        delta[i] = now.values[i] - phase_start.values[i];
+    }
+    phase_start = now;
+
+    // Never on the PMU during the phase, because of contention or a counter
+    // held by the NMI watchdog. Zeros would read as real counts.
+    out << frame << ',' << phase;
+    if (running == 0)
+    {
+        out << std::string(PerfCounters::COUNTER_COUNT + 4, ',') << ",0\n";
+        return;
+    }
+    if (running < enabled)
+    {
+        double scale = static_cast<double>(enabled) / running;
+        for (uint64_t &value : delta)
+        {
+            value = std::llround(value * scale);
+        }
+    }
+
+    for (std::size_t i = 0; i < PerfCounters::COUNTER_COUNT; ++i)
+    {
+        out << ',';
+        if (counters.has(static_cast<PerfCounters::Counter>(i))) out << delta[i];
+    }
+
+    bool instructions = counters.has(PerfCounters::INSTRUCTIONS) && delta[PerfCounters::INSTRUCTIONS] > 0;
+    double kilo_instructions = delta[PerfCounters::INSTRUCTIONS] / 1000.0;
+    out << ',';
+    if (instructions && counters.has(PerfCounters::CYCLES) && delta[PerfCounters::CYCLES] > 0)
+    {
+        out << static_cast<double>(delta[PerfCounters::INSTRUCTIONS]) / delta[PerfCounters::CYCLES];
+    }
+    for (PerfCounters::Counter miss : {PerfCounters::BRANCH_MISSES, PerfCounters::L1D_MISSES, PerfCounters::LLC_MISSES})
+    {
+        out << ',';
+        if (instructions && counters.has(miss)) out << delta[miss] / kilo_instructions;
+    }
+    out << ',' << static_cast<double>(running) / enabled << '\n';
+}
@@ -1,15 +1,16 @@
 #include "ppu.h"
 #include "bus.h"
+#include "savestate.h"
 
 #include <iostream>
 #include <iomanip>
 
 PPU::PPU() :
     registers{}, display{}, bus{nullptr},
-    v{}, w{false}, fine_x{},
+    v{}, w{false}, fine_x{}, line{}, dot{}, frame_done{false}, rendering{true},
     pt_l_input{}, pt_l_sr{},
     pt_h_input{}, pt_h_sr{},
-    nt_id{}, attr{}
+    nt_id{}, attr_input{}, attr_sr{}
 {}
 
 PPU::Registers *PPU::reg_ref()
@@ -17,6 +18,16 @@ PPU::Registers *PPU::reg_ref()
     return &registers;
 }
 
+const PPU::OAM *PPU::oam_ref() const
+{
+    return &oam;
+}
+
+PPU::OAM::Dirty *PPU::oam_dirty_ref()
+{
+    return oam.dirty_ref();
+}
+
 void PPU::attach_bus(Bus *new_bus)
 {
     bus = new_bus;
@@ -54,7 +65,7 @@ void PPU::clock_cycle()
     pt_l_sr >>= 1;
     pt_h_sr >>= 1;
 
-    if (pallete != 0 && line < 240)
+    if (rendering && pallete != 0 && line < 240)
     {
         display[((v&0x1F)<<3) | fine_x][line] = 1;
     }
@@ -74,6 +85,16 @@ void PPU::clock_cycle()
     {
         fine_x++;
     }
+
+    if (++dot == DOTS_PER_LINE)
+    {
+        dot = 0;
+        if (++line == LINES_PER_FRAME)
+        {
+            line = 0;
+            frame_done = true;
+        }
+    }
 }
 
 PPU::Display PPU::get_display()
@@ -81,7 +102,58 @@ PPU::Display PPU::get_display()
     return display;
 }
 
+const PPU::Display &PPU::display_ref() const
+{
+    return display;
+}
+
+void PPU::set_rendering(bool enabled)
+{
+    rendering = enabled;
+}
+
+// True once per frame, after the last dot of the pre-render line
 bool PPU::frame_complete()
 {
-    return true;
+    bool done = frame_done;
+    frame_done = false;
+    return done;
+}
+
+void PPU::save_state(StateWriter &writer) const
+{
+    registers.save_state(writer);
+    oam.save_state(writer);
+    writer.write(v);
+    writer.write(w);
+    writer.write(fine_x);
+    writer.write(line);
+    writer.write(dot);
+    writer.write(frame_done);
+    writer.write(nt_id);
+    writer.write(pt_l_input);
+    writer.write(pt_l_sr);
+    writer.write(pt_h_input);
+    writer.write(pt_h_sr);
+    writer.write(attr_input);
+    writer.write(attr_sr);
+}
+
+void PPU::load_state(StateReader &reader)
+{
+    registers.load_state(reader);
+    oam.load_state(reader);
+    reader.read(v);
+    reader.read(w);
+    reader.read(fine_x);
+    reader.read(line);
+    reader.read(dot);
+    reader.read(frame_done);
+    reader.read(nt_id);
+    reader.read(pt_l_input);
+    reader.read(pt_l_sr);
+    reader.read(pt_h_input);
+    reader.read(pt_h_sr);
+    reader.read(attr_input);
+    reader.read(attr_sr);
 }
\ No newline at end of file
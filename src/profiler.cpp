@@ -0,0 +1,162 @@
+#include "profiler.h"
+#include "mapper.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+#include <cstdio>
+
+static constexpr uint32_t NO_BANK = 0xFF;
+
+Profiler::Profiler(const Mapper *mapper, unsigned int interval) :
+    mapper(mapper), interval(std::max(interval, 1u)), countdown(this->interval),
+    stack{}, overflow{0}, call_pending{false},
+    samples{0}, pc_samples{}, stack_samples{}
+{
+    stack.reserve(MAX_DEPTH);
+}
+
+// bank << 16 | addr, with NO_BANK outside PRG ROM
+uint32_t Profiler::locate(uint16_t addr) const
+{
+    uint32_t bank = addr >= 0x8000 ? (mapper->prg_bank(addr) & 0xFF) : NO_BANK;
+    return (bank << 16) | addr;
+}
+
+static std::string location_name(uint32_t location)
+{
+    char name[16];
+    if ((location >> 16) == NO_BANK)
+    {
+        std::snprintf(name, sizeof(name), "--:%04X", location & 0xFFFF);
+    }
+    else
+    {
+        std::snprintf(name, sizeof(name), "%02X:%04X", location >> 16, location & 0xFFFF);
+    }
+    return name;
+}
+
+void Profiler::enter(uint16_t pc)
+{
+    call_pending = false;
+    if (stack.size() < MAX_DEPTH)
+    {
+        stack.push_back(locate(pc));
+    }
+    else
+    {
+        ++overflow;
+    }
+}
+
+// Returns with nothing on the stack come from code that was entered before
+// profiling started, or from RTS used as a jump; they are ignored.
+void Profiler::leave()
+{
+    if (overflow > 0)
+    {
+        --overflow;
+    }
+    else if (!stack.empty())
+    {
+        stack.pop_back();
+    }
+}
+
+void Profiler::sample(uint16_t pc)
+{
+    ++samples;
+    ++pc_samples[locate(pc)];
+    ++stack_samples[stack];
+}
+
+uint64_t Profiler::sample_count() const
+{
+    return samples;
+}
+
+// Samples per function (self: executing in it, total: anywhere on the stack)
+// and per PC, both as estimated cycles.
+void Profiler::write_flat(std::ostream &out) const
+{
+    struct FunctionSamples
+    {
+        uint64_t self;
+        uint64_t total;
+    };
+    std::unordered_map<uint32_t, FunctionSamples> functions;
+    for (const auto &[stack, count] : stack_samples)
+    {
+        uint32_t leaf = stack.empty() ? 0 : stack.back();
+        functions[leaf].self += count;
+        std::vector<uint32_t> seen;
+        for (uint32_t location : stack)
+        {
+            if (std::find(seen.begin(), seen.end(), location) != seen.end()) continue;
+            seen.push_back(location);
+            functions[location].total += count;
+        }
+        if (stack.empty()) functions[0].total += count;
+    }
+
+    std::vector<std::pair<uint32_t, FunctionSamples>> by_function(functions.begin(), functions.end());
+    std::sort(by_function.begin(), by_function.end(), [](const auto &a, const auto &b)
+    {
+        return a.second.self > b.second.self;
+    });
+    std::vector<std::pair<uint32_t, uint64_t>> by_pc(pc_samples.begin(), pc_samples.end());
+    std::sort(by_pc.begin(), by_pc.end(), [](const auto &a, const auto &b)
+    {
+        return a.second > b.second;
+    });
+
+    double percent = samples ? 100.0 / samples : 0.0;
+    out << std::fixed << std::setprecision(2);
+    out << "# " << samples << " samples, one every " << interval << " CPU cycles\n";
+    out << "# Functions by self time; [top] is code outside any tracked call\n";
+    out << "# self%   total%     self cycles  function\n";
+    for (const auto &[location, counts] : by_function)
+    {
+        out << std::setw(7) << counts.self * percent << ' ' << std::setw(8) << counts.total * percent << ' '
+            << std::setw(15) << counts.self * interval << "  "
+            << (location == 0 ? std::string("[top]") : location_name(location)) << '\n';
+    }
+    out << "\n# PCs by samples\n";
+    out << "#     %          cycles  pc\n";
+    for (const auto &[location, count] : by_pc)
+    {
+        out << std::setw(7) << count * percent << ' ' << std::setw(15) << count * interval
+            << "  " << location_name(location) << '\n';
+    }
+}
+
+// One line per distinct stack, "outer;...;inner count", as read by
+// flamegraph.pl and compatible tools. Counts are in estimated cycles.
+void Profiler::write_folded(std::ostream &out) const
+{
+    for (const auto &[stack, count] : stack_samples)
+    {
+        out << "[top]";
+        for (uint32_t location : stack)
+        {
+            out << ';' << location_name(location);
+        }
+        out << ' ' << count * interval << '\n';
+    }
+}
+
+// Writes <prefix>.txt with the flat profile and <prefix>.folded
+void Profiler::save(const std::string &prefix) const
+{
+    std::ofstream flat(prefix + ".txt");
+    std::ofstream folded(prefix + ".folded");
+    if (!flat.is_open() || !folded.is_open())
+    {
+        throw std::runtime_error("Failed to write profile " + prefix);
+    }
+    write_flat(flat);
+    write_folded(folded);
+}
@@ -0,0 +1,183 @@
+#include "rewind.h"
+#include "nes.h"
+
+#include <stdexcept>
+#include <cstring>
+
+// Record layout: repeated [u16 zero run][u16 literal count][literals]
+static void encode_xor(const uint8_t *data, const uint8_t *base, std::size_t size, std::vector<uint8_t> &out)
+{
+    out.clear();
+    std::size_t i = 0;
+    while (i < size)
+    {
+        std::size_t zeros = 0;
+        while (i < size && zeros < 0xFFFF && (data[i] ^ (base ? base[i] : 0)) == 0)
+        {
+            ++i;
+            ++zeros;
+        }
+        std::size_t literal_start = i;
+        while (i < size && i - literal_start < 0xFFFF && (data[i] ^ (base ? base[i] : 0)) != 0)
+        {
+            ++i;
+        }
+        std::size_t literals = i - literal_start;
+
+        out.push_back(zeros & 0xFF);
+        out.push_back(zeros >> 8);
+        out.push_back(literals & 0xFF);
+        out.push_back(literals >> 8);
+        for (std::size_t j = literal_start; j < i; ++j)
+        {
+            out.push_back(data[j] ^ (base ? base[j] : 0));
+        }
+    }
+}
+
+// XORs the decoded record into out, which holds the base (or zeros)
+static void apply_xor(const uint8_t *record, std::size_t record_size, uint8_t *out)
+{
+    std::size_t pos = 0;
+    std::size_t i = 0;
+    while (i + 4 <= record_size)
+    {
+        std::size_t zeros = record[i] | (record[i+1] << 8);
+        std::size_t literals = record[i+2] | (record[i+3] << 8);
+        i += 4;
+        pos += zeros;
+        for (std::size_t j = 0; j < literals; ++j)
+        {
+            out[pos++] ^= record[i++];
+        }
+    }
+}
+
+Rewind::Rewind(std::size_t state_size, std::size_t capacity, unsigned int keyframe_interval) :
+    ring(capacity), head{0}, snapshots{},
+    state(state_size), keyframe(state_size), encoded{},
+    keyframe_interval{keyframe_interval ? keyframe_interval : 1},
+    since_keyframe{this->keyframe_interval}, current_keyframe{}
+{
+    encoded.reserve(state_size + state_size / 8 + 16);
+}
+
+void Rewind::capture(const NES &nes)
+{
+    nes.save_state(state.data(), state.size());
+
+    if (since_keyframe < keyframe_interval)
+    {
+        encode_xor(state.data(), keyframe.data(), state.size(), encoded);
+        if (!overwrites_keyframe(encoded.size()))
+        {
+            store(Snapshot{0, encoded.size(), current_keyframe.offset, current_keyframe.size, false}, encoded);
+            since_keyframe++;
+            return;
+        }
+    }
+
+    encode_xor(state.data(), nullptr, state.size(), encoded);
+    std::memcpy(keyframe.data(), state.data(), state.size());
+    store(Snapshot{0, encoded.size(), 0, 0, true}, encoded);
+    current_keyframe = snapshots.back();
+    since_keyframe = 1;
+}
+
+// The newest snapshot is the current state, so this drops it and loads the
+// one before, which then becomes the newest
+bool Rewind::restore_previous(NES &nes)
+{
+    if (snapshots.size() < 2)
+    {
+        return false;
+    }
+
+    snapshots.pop_back();
+    decode(snapshots.back(), state);
+    nes.load_state(state.data(), state.size());
+
+    head = snapshots.back().offset + snapshots.back().size;
+    // The in-memory keyframe may now be newer than the state; start afresh.
+    since_keyframe = keyframe_interval;
+    return true;
+}
+
+std::size_t Rewind::frame_count() const
+{
+    return snapshots.size();
+}
+
+std::size_t Rewind::bytes_used() const
+{
+    std::size_t used = 0;
+    for (const auto &snapshot : snapshots)
+    {
+        used += snapshot.size;
+    }
+    return used;
+}
+
+void Rewind::store(const Snapshot &header, const std::vector<uint8_t> &data)
+{
+    if (data.size() > ring.size())
+    {
+        throw std::runtime_error("Rewind buffer is smaller than a single snapshot.");
+    }
+    if (head + data.size() > ring.size())
+    {
+        evict(head, ring.size());
+        head = 0;
+    }
+    evict(head, head + data.size());
+
+    Snapshot snapshot = header;
+    snapshot.offset = head;
+    std::memcpy(ring.data() + head, data.data(), data.size());
+    head += data.size();
+    snapshots.push_back(snapshot);
+}
+
+// Whether storing a record of this size would evict the keyframe it depends on
+bool Rewind::overwrites_keyframe(std::size_t size) const
+{
+    std::size_t start = head;
+    if (head + size > ring.size())
+    {
+        // Wrapping also evicts everything between head and the end of the ring
+        if (current_keyframe.offset + current_keyframe.size > head) return true;
+        start = 0;
+    }
+    return current_keyframe.offset < start + size
+        && current_keyframe.offset + current_keyframe.size > start;
+}
+
+// Drops the oldest snapshots overlapping [start, end). Deltas cannot outlive
+// their keyframe, so evicting a keyframe also evicts its dependants.
+void Rewind::evict(std::size_t start, std::size_t end)
+{
+    while (!snapshots.empty())
+    {
+        const Snapshot &oldest = snapshots.front();
+        if (oldest.offset >= end || oldest.offset + oldest.size <= start)
+        {
+            break;
+        }
+        bool was_keyframe = oldest.keyframe;
+        snapshots.pop_front();
+        while (was_keyframe && !snapshots.empty() && !snapshots.front().keyframe)
+        {
+            snapshots.pop_front();
+        }
+    }
+}
+
+void Rewind::decode(const Snapshot &snapshot, std::vector<uint8_t> &out) const
+{
+    std::memset(out.data(), 0, out.size());
+    if (!snapshot.keyframe)
+    {
+        apply_xor(ring.data() + snapshot.keyframe_offset, snapshot.keyframe_size, out.data());
+    }
+    apply_xor(ring.data() + snapshot.offset, snapshot.size, out.data());
+}
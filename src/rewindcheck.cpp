@@ -0,0 +1,76 @@
+#include "rewindcheck.h"
+#include "nes.h"
+
+#include <iostream>
+#include <vector>
+
+// Small keyframe interval, so both keyframes and deltas are restored
+static constexpr std::size_t CHECK_CAPACITY = 64 << 20;
+static constexpr unsigned int CHECK_KEYFRAME_INTERVAL = 8;
+
+// Rewinds one frame and compares against the state recorded for that frame
+static bool rewind_and_expect(NES &nes, const std::vector<std::vector<uint8_t>> &states)
+{
+    uint64_t frame = nes.get_frame() - 1;
+    if (!nes.rewind_frame())
+    {
+        std::cerr << "Rewind from frame " << frame + 1 << " failed" << std::endl;
+        return false;
+    }
+    if (nes.get_frame() != frame)
+    {
+        std::cerr << "Rewind reached frame " << nes.get_frame() << ", expected " << frame << std::endl;
+        return false;
+    }
+    std::vector<uint8_t> state(nes.state_size());
+    nes.save_state(state.data(), state.size());
+    if (state != states[frame - 1])
+    {
+        std::cerr << "State after rewinding to frame " << frame << " differs from the one recorded" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool check_rewind(const std::string &rom_path, unsigned int frames)
+{
+    if (frames < 2)
+    {
+        std::cerr << "Rewind check needs at least 2 frames" << std::endl;
+        return false;
+    }
+
+    NES nes(nullptr, rom_path);
+    nes.enable_rewind(CHECK_CAPACITY, CHECK_KEYFRAME_INTERVAL);
+    nes.reset();
+
+    // states[i] is the state after frame i + 1
+    std::vector<std::vector<uint8_t>> states;
+    auto step = [&]()
+    {
+        nes.step_frame();
+        std::vector<uint8_t> state(nes.state_size());
+        nes.save_state(state.data(), state.size());
+        states.resize(nes.get_frame() - 1);
+        states.push_back(std::move(state));
+    };
+
+    for (unsigned int i = 0; i < frames; ++i) step();
+    while (nes.get_frame() > frames / 2)
+    {
+        if (!rewind_and_expect(nes, states)) return false;
+    }
+    for (unsigned int i = 0; i < frames / 4; ++i) step();
+    while (nes.get_frame() > 1)
+    {
+        if (!rewind_and_expect(nes, states)) return false;
+    }
+    if (nes.rewind_frame())
+    {
+        std::cerr << "Rewind went back past the first recorded frame" << std::endl;
+        return false;
+    }
+
+    std::cout << "Rewind check passed over " << frames << " frames" << std::endl;
+    return true;
+}
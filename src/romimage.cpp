@@ -0,0 +1,96 @@
+#include "romimage.h"
+#include "checksum.h"
+
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+RomImage::RomImage(const std::string &path) :
+    data{nullptr}, size{0}, mapped{false}, buffer{}, header{}
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Failed to open ROM file: " + path);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        throw std::runtime_error("Failed to stat ROM file: " + path);
+    }
+    size = st.st_size;
+
+    void *mapping = (size > 0) ? mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    if (mapping != MAP_FAILED)
+    {
+        data = static_cast<const uint8_t*>(mapping);
+        mapped = true;
+    }
+    else
+    {
+        buffer.resize(size);
+        std::size_t done = 0;
+        while (done < size)
+        {
+            ssize_t n = read(fd, buffer.data() + done, size - done);
+            if (n <= 0)
+            {
+                close(fd);
+                throw std::runtime_error("Failed to read ROM file: " + path);
+            }
+            done += n;
+        }
+        data = buffer.data();
+    }
+    close(fd);
+
+    try
+    {
+        header = parse_ines_header(data, size);
+    }
+    catch (...)
+    {
+        if (mapped) munmap(const_cast<uint8_t*>(data), size);
+        throw;
+    }
+}
+
+RomImage::~RomImage()
+{
+    if (mapped)
+    {
+        munmap(const_cast<uint8_t*>(data), size);
+    }
+}
+
+const INESHeader &RomImage::get_header() const
+{
+    return header;
+}
+
+const uint8_t *RomImage::prg_data() const
+{
+    return data + header.prg_offset();
+}
+
+const uint8_t *RomImage::chr_data() const
+{
+    return (header.chr_rom_size > 0) ? data + header.chr_offset() : nullptr;
+}
+
+bool RomImage::is_mapped() const
+{
+    return mapped;
+}
+
+
+// CRC32 of PRG + CHR, which are contiguous in the file
+uint32_t RomImage::content_crc32() const
+{
+    return crc32(prg_data(), header.prg_rom_size + header.chr_rom_size);
+}
\ No newline at end of file
@@ -0,0 +1,236 @@
+#include "romlibrary.h"
+#include "romimage.h"
+#include "checksum.h"
+#include "parallel.h"
+
+#include <stdexcept>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <unordered_map>
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <cstring>
+#include <cctype>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace fs = std::filesystem;
+
+RomIndex::RomIndex(const std::string &path) :
+    data{nullptr}, size{0}, entries{nullptr}, count{0},
+    strings{nullptr}, strings_size{0}
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Failed to open ROM index: " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(RomIndexHeader)))
+    {
+        close(fd);
+        throw std::runtime_error("Invalid ROM index: " + path);
+    }
+    size = st.st_size;
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        throw std::runtime_error("Failed to map ROM index: " + path);
+    }
+    data = static_cast<const uint8_t*>(mapping);
+
+    const RomIndexHeader *header = reinterpret_cast<const RomIndexHeader*>(data);
+    std::size_t entries_end = sizeof(RomIndexHeader) + std::size_t(header->entry_count) * sizeof(RomIndexEntry);
+    if (std::memcmp(header->magic, RomIndexHeader::MAGIC, sizeof(header->magic)) != 0
+        || header->version != RomIndexHeader::VERSION
+        || entries_end > size
+        || header->strings_offset < entries_end
+        || header->strings_offset + header->strings_size > size)
+    {
+        munmap(mapping, size);
+        throw std::runtime_error("Invalid ROM index: " + path);
+    }
+
+    entries = reinterpret_cast<const RomIndexEntry*>(data + sizeof(RomIndexHeader));
+    count = header->entry_count;
+    strings = reinterpret_cast<const char*>(data + header->strings_offset);
+    strings_size = header->strings_size;
+}
+
+RomIndex::~RomIndex()
+{
+    munmap(const_cast<uint8_t*>(data), size);
+}
+
+std::size_t RomIndex::entry_count() const
+{
+    return count;
+}
+
+const RomIndexEntry &RomIndex::entry(std::size_t i) const
+{
+    return entries[i];
+}
+
+std::string_view RomIndex::path(const RomIndexEntry &entry) const
+{
+    if (std::size_t(entry.path_offset) + entry.path_length > strings_size)
+    {
+        return {};
+    }
+    return std::string_view(strings + entry.path_offset, entry.path_length);
+}
+
+const RomIndexEntry *RomIndex::find_crc32(uint32_t crc) const
+{
+    const RomIndexEntry *end = entries + count;
+    const RomIndexEntry *it = std::lower_bound(entries, end, crc,
+        [](const RomIndexEntry &e, uint32_t value) { return e.crc32 < value; });
+    return (it != end && it->crc32 == crc) ? it : nullptr;
+}
+
+static bool is_rom_file(const fs::path &path)
+{
+    std::string ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+    return ext == ".nes";
+}
+
+static RomIndexEntry read_entry(const std::string &path, const struct stat &st)
+{
+    RomImage image(path);
+    const INESHeader &header = image.get_header();
+
+    RomIndexEntry entry{};
+    // PRG and CHR are contiguous in the file, so both hashes cover one span.
+    std::size_t content_size = header.prg_rom_size + header.chr_rom_size;
+    entry.crc32 = crc32(image.prg_data(), content_size);
+    SHA1::Digest digest = SHA1::hash(image.prg_data(), content_size);
+    std::memcpy(entry.sha1, digest.data(), digest.size());
+    entry.file_size = st.st_size;
+    entry.mtime_ns = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    entry.prg_rom_size = header.prg_rom_size;
+    entry.chr_rom_size = header.chr_rom_size;
+    entry.prg_ram_size = header.prg_ram_size + header.prg_nvram_size;
+    entry.mapper = header.mapper;
+    entry.submapper = header.submapper;
+    entry.flags = (header.battery ? RomIndexEntry::BATTERY : 0)
+        | (header.trainer ? RomIndexEntry::TRAINER : 0)
+        | (header.nes2 ? RomIndexEntry::NES2 : 0)
+        | (header.mirroring << 4);
+    return entry;
+}
+
+RomScanStats index_rom_library(const std::string &root, const std::string &index_path, unsigned int threads)
+{
+    std::vector<std::string> paths;
+    for (const auto &entry : fs::recursive_directory_iterator(root, fs::directory_options::skip_permission_denied))
+    {
+        if (entry.is_regular_file() && is_rom_file(entry.path()))
+        {
+            paths.push_back(entry.path().string());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+
+    std::unique_ptr<RomIndex> previous;
+    std::unordered_map<std::string_view, const RomIndexEntry*> previous_entries;
+    if (fs::exists(index_path))
+    {
+        try
+        {
+            previous = std::make_unique<RomIndex>(index_path);
+            for (std::size_t i = 0; i < previous->entry_count(); ++i)
+            {
+                const RomIndexEntry &e = previous->entry(i);
+                previous_entries[previous->path(e)] = &e;
+            }
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Ignoring previous index: " << e.what() << std::endl;
+        }
+    }
+
+    std::vector<RomIndexEntry> entries(paths.size());
+    std::vector<char> valid(paths.size(), 0);
+    std::atomic<std::size_t> hashed{0};
+    std::atomic<std::size_t> reused{0};
+
+    parallel_for(paths.size(), [&](std::size_t i)
+    {
+        struct stat st;
+        if (stat(paths[i].c_str(), &st) != 0) return;
+        int64_t mtime_ns = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+
+        auto prev = previous_entries.find(paths[i]);
+        if (prev != previous_entries.end()
+            && prev->second->file_size == static_cast<uint64_t>(st.st_size)
+            && prev->second->mtime_ns == mtime_ns)
+        {
+            entries[i] = *prev->second;
+            valid[i] = 1;
+            reused++;
+            return;
+        }
+
+        try
+        {
+            entries[i] = read_entry(paths[i], st);
+            valid[i] = 1;
+            hashed++;
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Skipping " << paths[i] << ": " << e.what() << std::endl;
+        }
+    }, threads);
+
+    std::string string_table;
+    std::vector<RomIndexEntry> records;
+    for (std::size_t i = 0; i < paths.size(); ++i)
+    {
+        if (!valid[i]) continue;
+        entries[i].path_offset = string_table.size();
+        entries[i].path_length = paths[i].size();
+        string_table += paths[i];
+        records.push_back(entries[i]);
+    }
+    std::stable_sort(records.begin(), records.end(),
+        [](const RomIndexEntry &a, const RomIndexEntry &b) { return a.crc32 < b.crc32; });
+
+    // The previous index may still be mapped, so write a new file and rename it.
+    previous.reset();
+    RomIndexHeader header{};
+    std::memcpy(header.magic, RomIndexHeader::MAGIC, sizeof(header.magic));
+    header.version = RomIndexHeader::VERSION;
+    header.entry_count = records.size();
+    header.strings_offset = sizeof(RomIndexHeader) + records.size() * sizeof(RomIndexEntry);
+    header.strings_size = string_table.size();
+
+    const std::string temp_path = index_path + ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            throw std::runtime_error("Failed to write ROM index: " + temp_path);
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(RomIndexEntry));
+        file.write(string_table.data(), string_table.size());
+        if (!file)
+        {
+            throw std::runtime_error("Failed to write ROM index: " + temp_path);
+        }
+    }
+    fs::rename(temp_path, index_path);
+
+    return RomScanStats{hashed, reused, paths.size() - hashed - reused};
+}
@@ -0,0 +1,126 @@
+#include "romregistry.h"
+
+#include <string_view>
+#include <functional>
+#include <iterator>
+#include <cstring>
+
+#include <sys/stat.h>
+
+RomRegistry &RomRegistry::instance()
+{
+    static RomRegistry registry;
+    return registry;
+}
+
+bool RomRegistry::FileIdentity::operator==(const FileIdentity &other) const
+{
+    return dev == other.dev && ino == other.ino
+        && mtime_sec == other.mtime_sec && mtime_nsec == other.mtime_nsec
+        && size == other.size;
+}
+
+std::shared_ptr<const RomImage> RomRegistry::acquire(const std::string &path)
+{
+    struct stat st;
+    bool identified = stat(path.c_str(), &st) == 0;
+    FileIdentity identity{};
+    if (identified)
+    {
+        identity = FileIdentity{static_cast<uint64_t>(st.st_dev), static_cast<uint64_t>(st.st_ino),
+            st.st_mtim.tv_sec, st.st_mtim.tv_nsec, st.st_size};
+
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = files.find(path);
+        if (it != files.end() && it->second.identity == identity)
+        {
+            if (std::shared_ptr<const RomImage> existing = it->second.image.lock())
+            {
+                return existing;
+            }
+        }
+    }
+
+    // Unknown or changed file: map and hash it, then share by content.
+    auto image = find_or_insert(std::make_shared<const RomImage>(path));
+    if (identified)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        files[path] = FileEntry{identity, image};
+    }
+    return image;
+}
+
+// Returns the registered image with the same content as image, or registers
+// image itself
+std::shared_ptr<const RomImage> RomRegistry::find_or_insert(const std::shared_ptr<const RomImage> &image)
+{
+    std::size_t hash = content_hash(*image);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    prune();
+    auto range = images.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        std::shared_ptr<const RomImage> existing = it->second.lock();
+        if (existing && same_content(*existing, *image))
+        {
+            return existing;
+        }
+    }
+
+    images.emplace(hash, image);
+    return image;
+}
+
+// Drops entries of released images, so a process opening many ROMs over its
+// lifetime keeps only the live ones. Runs on misses, which already hash a
+// whole file, so the sweep is cheap in comparison. Call with mutex held.
+void RomRegistry::prune()
+{
+    for (auto it = images.begin(); it != images.end();)
+    {
+        it = it->second.expired() ? images.erase(it) : std::next(it);
+    }
+    for (auto it = files.begin(); it != files.end();)
+    {
+        it = it->second.image.expired() ? files.erase(it) : std::next(it);
+    }
+}
+
+std::size_t RomRegistry::loaded_count()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::size_t count = 0;
+    for (const auto &entry : images)
+    {
+        if (!entry.second.expired()) ++count;
+    }
+    return count;
+}
+
+std::size_t RomRegistry::content_hash(const RomImage &image)
+{
+    const INESHeader &header = image.get_header();
+    std::size_t hash = std::hash<std::string_view>{}(std::string_view(
+        reinterpret_cast<const char*>(image.prg_data()), header.prg_rom_size));
+    if (header.chr_rom_size > 0)
+    {
+        hash ^= std::hash<std::string_view>{}(std::string_view(
+            reinterpret_cast<const char*>(image.chr_data()), header.chr_rom_size)) * 31;
+    }
+    return hash ^ header.mapper;
+}
+
+bool RomRegistry::same_content(const RomImage &a, const RomImage &b)
+{
+    const INESHeader &ha = a.get_header();
+    const INESHeader &hb = b.get_header();
+    if (ha.mapper != hb.mapper || ha.mirroring != hb.mirroring
+        || ha.prg_rom_size != hb.prg_rom_size || ha.chr_rom_size != hb.chr_rom_size)
+    {
+        return false;
+    }
+    return std::memcmp(a.prg_data(), b.prg_data(), ha.prg_rom_size) == 0
+        && (ha.chr_rom_size == 0 || std::memcmp(a.chr_data(), b.chr_data(), ha.chr_rom_size) == 0);
+}
@@ -0,0 +1,162 @@
+#include "saveram.h"
+#include "checksum.h"
+#include "trace.h"
+
+#include <iostream>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static std::size_t round_up_pow2(std::size_t size)
+{
+    std::size_t rounded = 1;
+    while (rounded < size) rounded <<= 1;
+    return rounded;
+}
+
+SaveRam::SaveRam(std::size_t size) :
+    Dirty(round_up_pow2(size)),
+    memory(round_up_pow2(size)), size{memory.size()}, mask{this->size - 1},
+    persistent{nullptr}, diverged{false}, speculative{false}, dirty{false},
+    flush_interval{DEFAULT_FLUSH_INTERVAL}, stopping{false}
+{}
+
+SaveRam::SaveRam(std::size_t size, const std::string &save_path, std::chrono::milliseconds flush_interval) :
+    SaveRam(size)
+{
+    this->flush_interval = flush_interval;
+
+    int fd = open(save_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0
+        || (st.st_size < static_cast<off_t>(this->size) && ftruncate(fd, this->size) != 0))
+    {
+        std::cerr << "Failed to open save file " << save_path
+            << ", battery RAM will not persist" << std::endl;
+        if (fd >= 0) close(fd);
+        return;
+    }
+
+    void *mapping = mmap(nullptr, this->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        std::cerr << "Failed to map save file " << save_path
+            << ", battery RAM will not persist" << std::endl;
+        return;
+    }
+
+    persistent = static_cast<uint8_t*>(mapping);
+    std::memcpy(memory.data(), persistent, this->size);
+    flusher = std::thread(&SaveRam::flush_loop, this);
+}
+
+SaveRam::~SaveRam()
+{
+    if (flusher.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        flusher.join();
+    }
+
+    if (persistent)
+    {
+        flush();
+        munmap(persistent, size);
+    }
+}
+
+uint8_t SaveRam::get(uint16_t addr)
+{
+    return memory[addr & mask];
+}
+
+void SaveRam::set(uint16_t addr, uint8_t val)
+{
+    memory[addr & mask] = val;
+    Dirty::mark(addr & mask);
+    if (persistent && !speculative) publish(addr & mask, val);
+}
+
+// Copies a guest write to the save file, or all of the RAM after a state
+// load made them differ
+void SaveRam::publish(std::size_t offset, uint8_t val)
+{
+    if (diverged)
+    {
+        std::memcpy(persistent, memory.data(), size);
+        diverged = false;
+    }
+    else
+    {
+        persistent[offset] = val;
+    }
+    dirty.store(true, std::memory_order_relaxed);
+}
+
+void SaveRam::save_state(StateWriter &writer) const
+{
+    writer.write_bytes(memory.data(), size);
+}
+
+// Only the RAM is restored; the save file keeps what the guest last wrote
+void SaveRam::load_state(StateReader &reader)
+{
+    reader.read_bytes(memory.data(), size);
+    Dirty::mark_all();
+    if (persistent)
+    {
+        diverged = std::memcmp(memory.data(), persistent, size) != 0;
+    }
+}
+
+// While set, guest writes only change the RAM, for frames that are emulated
+// and then undone by loading a state, as run-ahead does
+void SaveRam::set_speculative(bool speculative)
+{
+    this->speculative = speculative;
+}
+
+void SaveRam::flush()
+{
+    if (persistent && dirty.exchange(false, std::memory_order_relaxed))
+    {
+        TRACE_SCOPE("save flush");
+        msync(persistent, size, MS_SYNC);
+    }
+}
+
+bool SaveRam::is_persistent() const
+{
+    return persistent != nullptr;
+}
+
+SaveRam::Dirty *SaveRam::dirty_ref()
+{
+    return this;
+}
+
+uint32_t SaveRam::content_crc32() const
+{
+    return crc32(memory.data(), size);
+}
+
+void SaveRam::flush_loop()
+{
+    TRACE_THREAD_NAME("save flusher");
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping)
+    {
+        wake.wait_for(lock, flush_interval, [this]() { return stopping; });
+        lock.unlock();
+        flush();
+        lock.lock();
+    }
+}
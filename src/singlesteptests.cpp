@@ -1,6 +1,11 @@
+#include "singlesteptests.h"
 #include "mem.h"
+#include "journalmem.h"
 #include "cpu.h"
 #include "bus.h"
+#include "parallel.h"
+#include "testvectors.h"
+#include "trace.h"
 
 #include "nlohmann/json.hpp"
 
@@ -13,43 +18,200 @@
 #include <sstream>
 #include <vector>
 #include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <chrono>
+#include <limits>
+#include <type_traits>
 
 
 namespace fs = std::filesystem;
 
-bool perform_tests(const nlohmann::json &tests)
+// Cases per task; small enough that one slow file still spreads across cores
+static constexpr std::size_t CHUNK_SIZE = 500;
+
+struct TestFileResult
 {
-    for (auto &test_case : tests)
-    {
-        Mem<1<<16> mem;
-        CPU cpu;
+    fs::path path;
+    int opcode;
+    std::size_t cases;
+    std::atomic<std::size_t> failed;
+    std::mutex mutex;
+    std::size_t first_failure; // Lowest failing index, whichever worker found it
+};
 
-        cpu.load_json(test_case["initial"]);
-        mem.load_json(test_case["initial"]);
+// Per-worker CPU, bus and memory, reset between cases rather than rebuilt
+struct TestRig
+{
+    JournalMem mem;
+    CPU cpu;
+    Bus bus;
 
-        Bus bus;
+    TestRig() :
+        mem(), cpu(), bus()
+    {
         bus.map_device(0x0, 0xFFFF, &mem);
         cpu.attach_bus(&bus);
+    }
 
+    TestRig(const TestRig &) = delete;
+    TestRig &operator=(const TestRig &) = delete;
+
+    void reset()
+    {
+        mem.reset();
+        cpu.reset();
+        bus.reset();
+    }
+
+    void run_instruction()
+    {
         do
         {
             bus.start_cycle();
             cpu.clock_cycle();
         }
         while (cpu.mid_instruction());
+    }
+};
+
+// Runs a case on fresh components and prints every mismatch
+void analyse_test(const nlohmann::json &test_case)
+{
+    Mem<1<<16> mem;
+    CPU cpu;
+
+    cpu.load_json(test_case["initial"]);
+    mem.load_json(test_case["initial"]);
+
+    Bus bus;
+    bus.map_device(0x0, 0xFFFF, &mem);
+    cpu.attach_bus(&bus);
+
+    do
+    {
+        bus.start_cycle();
+        cpu.clock_cycle();
+    }
+    while (cpu.mid_instruction());
+
+    cpu.analyse_state(test_case["final"]);
+    mem.analyse_state(test_case["final"]);
+    bus.analyse_operations(test_case["cycles"]);
+}
+
+bool perform_test(TestRig &rig, const nlohmann::json &test_case)
+{
+    rig.reset();
+    rig.cpu.load_json(test_case["initial"]);
+    for (const auto &entry : test_case["initial"]["ram"])
+    {
+        rig.mem.set(entry[0].get<uint16_t>(), entry[1].get<uint8_t>());
+    }
+
+    rig.run_instruction();
+
+    if (!rig.cpu.verify_state(test_case["final"]) ||
+        !rig.bus.verify_operations(test_case["cycles"]))
+    {
+        return false;
+    }
+    for (const auto &entry : test_case["final"]["ram"])
+    {
+        if (rig.mem.get(entry[0].get<uint16_t>()) != entry[1].get<uint8_t>()) return false;
+    }
+
+    return true;
+}
+
+// Same checks as the JSON path, except that the bus operation count must
+// match exactly
+bool perform_test(TestRig &rig, const TestVectorFile &vectors, std::size_t i)
+{
+    const TestCaseRecord &record = vectors.test_case(i);
+
+    rig.reset();
+    rig.cpu.set_registers(record.initial);
+    const TestRamEntry *initial_ram = vectors.ram_entries(record.initial_ram);
+    for (uint16_t j = 0; j < record.initial_ram_count; ++j)
+    {
+        rig.mem.set(initial_ram[j].addr, initial_ram[j].val);
+    }
+
+    rig.run_instruction();
 
-        if (!cpu.verify_state(test_case["final"]) ||
-            !mem.verify_state(test_case["final"]) ||
-            !bus.verify_operations(test_case["cycles"]))
+    CPURegisters regs = rig.cpu.get_registers();
+    const CPURegisters &expected = record.final;
+    if (regs.pc != expected.pc || regs.a != expected.a || regs.x != expected.x
+        || regs.y != expected.y || regs.s != expected.s || regs.p != expected.p)
+    {
+        return false;
+    }
+
+    const TestRamEntry *final_ram = vectors.ram_entries(record.final_ram);
+    for (uint16_t j = 0; j < record.final_ram_count; ++j)
+    {
+        if (rig.mem.get(final_ram[j].addr) != final_ram[j].val) return false;
+    }
+
+    const std::vector<BusOperation> &operations = rig.bus.operations_ref();
+    const TestCycle *cycles = vectors.cycle_entries(record.cycles);
+    if (operations.size() != record.cycle_count) return false;
+    for (uint16_t j = 0; j < record.cycle_count; ++j)
+    {
+        BusOperationType type = cycles[j].write ? BusOperationType::WRITE : BusOperationType::READ;
+        if (operations[j].addr != cycles[j].addr || operations[j].val != cycles[j].val
+            || operations[j].type != type)
         {
-            cpu.analyse_state(test_case["final"]);
-            mem.analyse_state(test_case["final"]);
-            bus.analyse_operations(test_case["cycles"]);
             return false;
         }
     }
-    
-    return true;
+
+    return rig.bus.conflict_check();
+}
+
+static void record_failure(TestFileResult &result, std::size_t i)
+{
+    result.failed++;
+    std::lock_guard<std::mutex> lock(result.mutex);
+    result.first_failure = std::min(result.first_failure, i);
+}
+
+// Runs cases [begin, end) from either the parsed JSON or compiled vectors
+template<typename Tests>
+static void perform_tests(TestRig &rig, const Tests &tests, std::size_t begin, std::size_t end,
+    TestFileResult &result)
+{
+    for (std::size_t i = begin; i < end; ++i)
+    {
+        bool passed;
+        if constexpr (std::is_same_v<Tests, TestVectorFile>)
+        {
+            passed = perform_test(rig, tests, i);
+        }
+        else
+        {
+            passed = perform_test(rig, tests[i]);
+        }
+        if (!passed) record_failure(result, i);
+    }
+}
+
+template<typename Tests>
+static void queue_chunks(WorkStealingPool &pool, unsigned int worker, std::vector<TestRig> &rigs,
+    std::shared_ptr<const Tests> tests, std::size_t count, TestFileResult &result)
+{
+    result.cases = count;
+    for (std::size_t begin = 0; begin < count; begin += CHUNK_SIZE)
+    {
+        std::size_t end = std::min(begin + CHUNK_SIZE, count);
+        pool.push(worker, [tests, begin, end, &result, &rigs](unsigned int worker)
+        {
+            TRACE_SCOPE("test chunk");
+            perform_tests(rigs[worker], *tests, begin, end, result);
+        });
+    }
 }
 
 // Set of official 6502 opcodes
@@ -95,7 +257,12 @@ std::vector<fs::path> get_json_files(const std::string &directory)
     return  json_files;
 }
 
-void run_tests(const std::string &test_dir)
+// Each opcode file is loaded by one worker, which then queues its cases in
+// chunks that idle workers steal. Results are printed in opcode order once
+// everything has finished, so the output does not depend on scheduling.
+// With a cache_dir, files are compiled to binary vectors there on first use
+// (or when the JSON is newer) and run from those.
+void run_tests(const std::string &test_dir, unsigned int threads, const std::string &cache_dir)
 {
     std::vector<fs::path> json_files = get_json_files(test_dir);
 
@@ -103,16 +270,68 @@ void run_tests(const std::string &test_dir)
         return std::stoi(a.stem().string(), nullptr, 16) < std::stoi(b.stem().string(), nullptr, 16);
     });
 
-    for (const auto& json_file : json_files)
+    std::vector<TestFileResult> results(json_files.size());
+    WorkStealingPool pool(threads);
+    std::vector<TestRig> rigs(pool.size());
+    for (std::size_t i = 0; i < json_files.size(); ++i)
     {
-        std::ifstream json_stream(json_file);
-        nlohmann::json tests = nlohmann::json::parse(json_stream);
+        TestFileResult &result = results[i];
+        result.path = json_files[i];
+        result.opcode = std::stoi(json_files[i].stem().string(), nullptr, 16);
+        result.cases = 0;
+        result.failed = 0;
+        result.first_failure = std::numeric_limits<std::size_t>::max();
+
+        pool.push(i, [&pool, &rigs, &result, &cache_dir](unsigned int worker)
+        {
+            if (!cache_dir.empty())
+            {
+                fs::path bin_path = fs::path(cache_dir) / (result.path.stem().string() + ".bin");
+                {
+                    TRACE_SCOPE("compile test vectors");
+                    compile_test_vectors(result.path.string(), bin_path.string());
+                }
+                auto vectors = std::make_shared<const TestVectorFile>(bin_path.string());
+                queue_chunks(pool, worker, rigs, vectors, vectors->case_count(), result);
+            }
+            else
+            {
+                std::ifstream json_stream(result.path);
+                auto tests = std::make_shared<const nlohmann::json>(nlohmann::json::parse(json_stream));
+                queue_chunks(pool, worker, rigs, tests, tests->size(), result);
+            }
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    pool.run();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
 
-        bool passed = perform_tests(tests);
+    std::size_t total_cases = 0;
+    std::size_t total_failed = 0;
+    for (TestFileResult &result : results)
+    {
+        total_cases += result.cases;
+        total_failed += result.failed;
+        if (result.failed > 0)
+        {
+            // Re-run the first failure alone from the JSON so its diagnostics are readable
+            std::ifstream json_stream(result.path);
+            nlohmann::json tests = nlohmann::json::parse(json_stream);
+            analyse_test(tests[result.first_failure]);
+        }
 
-        int opcode = std::stoi(json_file.stem().string(), nullptr, 16);
         std::cout << "0x" << std::uppercase << std::hex
-                  << std::setfill('0') << std::setw(2) << opcode
-                  << " : " << (passed ? "PASS" : "FAIL") << std::endl;
+                  << std::setfill('0') << std::setw(2) << result.opcode
+                  << " : " << (result.failed == 0 ? "PASS" : "FAIL");
+        if (result.failed > 0)
+        {
+            std::cout << std::dec << " (" << result.failed << "/" << result.cases << " failed)";
+        }
+        std::cout << std::endl;
     }
-}
\ No newline at end of file
+
+    std::cout << std::dec << total_cases << " cases, " << total_failed << " failed in "
+              << elapsed.count() << "s (" << static_cast<std::size_t>(total_cases / elapsed.count())
+              << " cases/s on " << pool.size() << " threads)" << std::endl;
+}
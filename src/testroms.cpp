@@ -0,0 +1,204 @@
+#include "testroms.h"
+#include "nes.h"
+#include "parallel.h"
+#include "trace.h"
+
+#include <stdexcept>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+
+namespace fs = std::filesystem;
+
+enum TestRomStatus
+{
+    PASSED,
+    FAILED,
+    TIMED_OUT,
+    ERROR
+};
+
+struct TestRom
+{
+    std::string path;
+    uint64_t cycle_budget;
+    bool has_frame_crc;
+    uint32_t frame_crc; // Screen of a passing run, for ROMs without $6000 output
+};
+
+struct TestRomResult
+{
+    TestRomStatus status;
+    int code;
+    std::string message;
+    uint64_t cycles;
+    double seconds;
+    uint32_t frame_crc;
+};
+
+// blargg's protocol: $6001-$6003 hold DE B0 61 once $6000 is valid. $6000 is
+// $80 while running, $81 when the ROM wants a reset, otherwise the result
+// code, and $6004 holds NUL-terminated text.
+static constexpr uint16_t STATUS_ADDR = 0x6000;
+static constexpr uint8_t SIGNATURE[3] = {0xDE, 0xB0, 0x61};
+static constexpr uint8_t STATUS_RUNNING = 0x80;
+static constexpr uint8_t STATUS_RESET = 0x81;
+static constexpr unsigned int RESET_DELAY_FRAMES = 6; // The protocol asks for at least 100 ms
+
+static std::vector<TestRom> read_manifest(const std::string &manifest_path)
+{
+    std::ifstream file(manifest_path);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Failed to open test ROM manifest: " + manifest_path);
+    }
+
+    fs::path root = fs::path(manifest_path).parent_path();
+    std::vector<TestRom> roms;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        TestRom rom{};
+        std::string path;
+        if (!(fields >> path)) continue;
+        if (!(fields >> rom.cycle_budget))
+        {
+            throw std::runtime_error("Test ROM without a cycle budget: " + path);
+        }
+        rom.has_frame_crc = static_cast<bool>(fields >> std::hex >> rom.frame_crc);
+        rom.path = (root / path).string();
+        roms.push_back(rom);
+    }
+    return roms;
+}
+
+static bool has_signature(NES &nes)
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        if (nes.peek_memory(STATUS_ADDR + 1 + i) != SIGNATURE[i]) return false;
+    }
+    return true;
+}
+
+static std::string read_text(NES &nes)
+{
+    std::string text;
+    for (uint16_t addr = STATUS_ADDR + 4; addr < 0x8000; ++addr)
+    {
+        char c = nes.peek_memory(addr);
+        if (c == '\0') break;
+        text += c;
+    }
+    return text;
+}
+
+// Completion is only checked between frames, so the budget can overrun by
+// up to one frame.
+static TestRomResult run_test_rom(const TestRom &rom)
+{
+    TestRomResult result{TestRomStatus::TIMED_OUT, 0, "", 0, 0.0, 0};
+    auto start = std::chrono::steady_clock::now();
+    try
+    {
+        NES nes(nullptr, rom.path);
+        nes.reset();
+        uint64_t reset_frame = 0;
+        bool reset_pending = false;
+        while (nes.get_cycles() < rom.cycle_budget)
+        {
+            nes.step_frame();
+
+            if (has_signature(nes))
+            {
+                uint8_t status = nes.peek_memory(STATUS_ADDR);
+                if (status == STATUS_RESET && !reset_pending)
+                {
+                    reset_pending = true;
+                    reset_frame = nes.get_frame() + RESET_DELAY_FRAMES;
+                }
+                else if (status < STATUS_RUNNING)
+                {
+                    result.status = (status == 0) ? TestRomStatus::PASSED : TestRomStatus::FAILED;
+                    result.code = status;
+                    result.message = read_text(nes);
+                    break;
+                }
+                if (reset_pending && nes.get_frame() >= reset_frame)
+                {
+                    reset_pending = false;
+                    nes.reset();
+                }
+            }
+            else if (rom.has_frame_crc && nes.frame_crc32() == rom.frame_crc)
+            {
+                result.status = TestRomStatus::PASSED;
+                break;
+            }
+        }
+        result.cycles = nes.get_cycles();
+        result.frame_crc = nes.frame_crc32();
+    }
+    catch (const std::exception &e)
+    {
+        result.status = TestRomStatus::ERROR;
+        result.message = e.what();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    result.seconds = elapsed.count();
+    return result;
+}
+
+bool run_test_roms(const std::string &manifest_path, unsigned int threads)
+{
+    std::vector<TestRom> roms = read_manifest(manifest_path);
+    std::vector<TestRomResult> results(roms.size());
+
+    auto start = std::chrono::steady_clock::now();
+    parallel_for(roms.size(), [&](std::size_t i)
+    {
+        TRACE_SCOPE("test rom");
+        results[i] = run_test_rom(roms[i]);
+    }, threads);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    static const char *status_names[] = {"PASS", "FAIL", "TIMEOUT", "ERROR"};
+    std::size_t passed = 0;
+    uint64_t total_cycles = 0;
+    for (std::size_t i = 0; i < roms.size(); ++i)
+    {
+        const TestRomResult &result = results[i];
+        passed += result.status == TestRomStatus::PASSED;
+        total_cycles += result.cycles;
+
+        std::cout << std::left << std::setw(8) << status_names[result.status] << std::right
+                  << std::dec << std::setw(12) << result.cycles << " cycles "
+                  << std::fixed << std::setprecision(3) << std::setw(8) << result.seconds << "s  "
+                  << fs::relative(roms[i].path, fs::path(manifest_path).parent_path()).string();
+        if (result.status == TestRomStatus::FAILED)
+        {
+            std::cout << " (code " << result.code << ")";
+        }
+        if (result.status == TestRomStatus::TIMED_OUT)
+        {
+            std::cout << " (frame crc " << std::hex << std::setw(8) << std::setfill('0')
+                      << result.frame_crc << std::setfill(' ') << std::dec << ")";
+        }
+        std::cout << std::endl;
+        if (result.status != TestRomStatus::PASSED && !result.message.empty())
+        {
+            std::cout << "    " << result.message << std::endl;
+        }
+    }
+
+    std::cout << passed << "/" << roms.size() << " passed, " << total_cycles << " cycles in "
+              << std::setprecision(3) << elapsed.count() << "s ("
+              << std::setprecision(1) << total_cycles / elapsed.count() / 1e6 << " M cycles/s)" << std::endl;
+    return passed == roms.size();
+}
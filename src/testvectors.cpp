@@ -0,0 +1,174 @@
+#include "testvectors.h"
+
+#include "nlohmann/json.hpp"
+
+#include <stdexcept>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace fs = std::filesystem;
+
+static CPURegisters registers_from_json(const nlohmann::json &json)
+{
+    return CPURegisters{
+        json["pc"].get<uint16_t>(), json["a"].get<uint8_t>(), json["x"].get<uint8_t>(),
+        json["y"].get<uint8_t>(), json["s"].get<uint8_t>(), json["p"].get<uint8_t>()
+    };
+}
+
+static uint16_t append_ram(const nlohmann::json &json, std::vector<TestRamEntry> &ram)
+{
+    for (const auto &entry : json["ram"])
+    {
+        ram.push_back(TestRamEntry{entry[0].get<uint16_t>(), entry[1].get<uint8_t>(), 0});
+    }
+    return json["ram"].size();
+}
+
+static bool is_current(const std::string &json_path, const std::string &bin_path)
+{
+    std::error_code error;
+    if (!fs::exists(bin_path, error)
+        || fs::last_write_time(bin_path, error) < fs::last_write_time(json_path, error))
+    {
+        return false;
+    }
+
+    std::ifstream file(bin_path, std::ios::binary);
+    TestVectorHeader header{};
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    return file && std::memcmp(header.magic, TestVectorHeader::MAGIC, sizeof(header.magic)) == 0
+        && header.version == TestVectorHeader::VERSION;
+}
+
+bool compile_test_vectors(const std::string &json_path, const std::string &bin_path)
+{
+    if (is_current(json_path, bin_path)) return false;
+
+    std::ifstream json_stream(json_path);
+    nlohmann::json tests = nlohmann::json::parse(json_stream);
+
+    std::vector<TestCaseRecord> records;
+    std::vector<TestRamEntry> ram;
+    std::vector<TestCycle> cycles;
+    records.reserve(tests.size());
+    for (const auto &test_case : tests)
+    {
+        TestCaseRecord record{};
+        record.initial = registers_from_json(test_case["initial"]);
+        record.final = registers_from_json(test_case["final"]);
+        record.initial_ram = ram.size();
+        record.initial_ram_count = append_ram(test_case["initial"], ram);
+        record.final_ram = ram.size();
+        record.final_ram_count = append_ram(test_case["final"], ram);
+        record.cycles = cycles.size();
+        record.cycle_count = test_case["cycles"].size();
+        for (const auto &cycle : test_case["cycles"])
+        {
+            bool write = cycle[2].get<std::string>() != "read";
+            cycles.push_back(TestCycle{cycle[0].get<uint16_t>(), cycle[1].get<uint8_t>(), write});
+        }
+        records.push_back(record);
+    }
+
+    TestVectorHeader header{};
+    std::memcpy(header.magic, TestVectorHeader::MAGIC, sizeof(header.magic));
+    header.version = TestVectorHeader::VERSION;
+    header.case_count = records.size();
+    header.ram_count = ram.size();
+    header.cycle_count = cycles.size();
+
+    fs::create_directories(fs::path(bin_path).parent_path());
+    const std::string temp_path = bin_path + ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            throw std::runtime_error("Failed to write test vectors: " + temp_path);
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(TestCaseRecord));
+        file.write(reinterpret_cast<const char*>(ram.data()), ram.size() * sizeof(TestRamEntry));
+        file.write(reinterpret_cast<const char*>(cycles.data()), cycles.size() * sizeof(TestCycle));
+        if (!file)
+        {
+            throw std::runtime_error("Failed to write test vectors: " + temp_path);
+        }
+    }
+    fs::rename(temp_path, bin_path);
+    return true;
+}
+
+TestVectorFile::TestVectorFile(const std::string &path) :
+    data{nullptr}, size{0}, records{nullptr}, ram{nullptr}, cycles{nullptr}, count{0}
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Failed to open test vectors: " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(TestVectorHeader)))
+    {
+        close(fd);
+        throw std::runtime_error("Invalid test vectors: " + path);
+    }
+    size = st.st_size;
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        throw std::runtime_error("Failed to map test vectors: " + path);
+    }
+    data = static_cast<const uint8_t*>(mapping);
+
+    const TestVectorHeader *header = reinterpret_cast<const TestVectorHeader*>(data);
+    std::size_t records_offset = sizeof(TestVectorHeader);
+    std::size_t ram_offset = records_offset + std::size_t(header->case_count) * sizeof(TestCaseRecord);
+    std::size_t cycles_offset = ram_offset + std::size_t(header->ram_count) * sizeof(TestRamEntry);
+    std::size_t end = cycles_offset + std::size_t(header->cycle_count) * sizeof(TestCycle);
+    if (std::memcmp(header->magic, TestVectorHeader::MAGIC, sizeof(header->magic)) != 0
+        || header->version != TestVectorHeader::VERSION
+        || end != size)
+    {
+        munmap(mapping, size);
+        throw std::runtime_error("Invalid test vectors: " + path);
+    }
+
+    records = reinterpret_cast<const TestCaseRecord*>(data + records_offset);
+    ram = reinterpret_cast<const TestRamEntry*>(data + ram_offset);
+    cycles = reinterpret_cast<const TestCycle*>(data + cycles_offset);
+    count = header->case_count;
+}
+
+TestVectorFile::~TestVectorFile()
+{
+    munmap(const_cast<uint8_t*>(data), size);
+}
+
+std::size_t TestVectorFile::case_count() const
+{
+    return count;
+}
+
+const TestCaseRecord &TestVectorFile::test_case(std::size_t i) const
+{
+    return records[i];
+}
+
+const TestRamEntry *TestVectorFile::ram_entries(uint32_t first) const
+{
+    return ram + first;
+}
+
+const TestCycle *TestVectorFile::cycle_entries(uint32_t first) const
+{
+    return cycles + first;
+}
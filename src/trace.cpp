@@ -0,0 +1,117 @@
+#include "trace.h"
+
+#include <fstream>
+#include <iostream>
+#include <chrono>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+static uint64_t trace_clock_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+TraceBuffer::TraceBuffer(uint32_t thread_id) :
+    events(new TraceEvent[CAPACITY]), count{0}, dropped{0},
+    thread_id(thread_id), thread_name{nullptr}
+{}
+
+Tracer &Tracer::instance()
+{
+    static Tracer tracer;
+    return tracer;
+}
+
+TraceBuffer &Tracer::thread_buffer()
+{
+    thread_local TraceBuffer *buffer = nullptr;
+    if (!buffer)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        buffers.push_back(std::make_unique<TraceBuffer>(static_cast<uint32_t>(buffers.size() + 1)));
+        buffer = buffers.back().get();
+    }
+    return *buffer;
+}
+
+// Shown for the thread in the viewer; name must be a string literal
+void Tracer::name_thread(const char *name)
+{
+    thread_buffer().thread_name.store(name, std::memory_order_relaxed);
+}
+
+// Where write() without a path, on demand or at exit, puts the trace
+void Tracer::set_output(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    output_path = path;
+}
+
+bool Tracer::write()
+{
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        path = output_path;
+    }
+    return !path.empty() && write(path);
+}
+
+// Writes every span recorded so far in Trace Event Format. Threads may keep
+// recording meanwhile; their later spans are simply not included.
+bool Tracer::write(const std::string &path)
+{
+    std::ofstream out(path + ".tmp");
+    if (!out.is_open())
+    {
+        std::cerr << "Failed to write trace " << path << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    uint64_t dropped = 0;
+    for (const auto &buffer : buffers)
+    {
+        const char *name = buffer->thread_name.load(std::memory_order_relaxed);
+        if (name)
+        {
+            out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+                << buffer->thread_id << ",\"args\":{\"name\":\"" << name << "\"}}";
+            first = false;
+        }
+
+        std::size_t count = buffer->count.load(std::memory_order_acquire);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const TraceEvent &event = buffer->events[i];
+            out << (first ? "" : ",\n") << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+                << buffer->thread_id << ",\"ts\":" << event.start_ns / 1000 << '.'
+                << (event.start_ns / 100) % 10 << ",\"dur\":" << event.duration_ns / 1000 << '.'
+                << (event.duration_ns / 100) % 10 << '}';
+            first = false;
+        }
+        dropped += buffer->dropped.load(std::memory_order_relaxed);
+    }
+    out << "\n]}\n";
+    out.close();
+
+    if (dropped)
+    {
+        std::cerr << "Trace buffers were full, " << dropped << " spans dropped" << std::endl;
+    }
+    fs::rename(path + ".tmp", path);
+    return true;
+}
+
+TraceScope::TraceScope(const char *name) :
+    name(name), start_ns(trace_clock_ns())
+{}
+
+TraceScope::~TraceScope()
+{
+    Tracer::instance().thread_buffer().record(name, start_ns, trace_clock_ns() - start_ns);
+}
@@ -0,0 +1,114 @@
+#include "warmstart.h"
+#include "nes.h"
+#include "version.h"
+
+#include <stdexcept>
+#include <fstream>
+#include <filesystem>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+
+namespace fs = std::filesystem;
+
+struct WarmStartHeader
+{
+    char magic[8];
+    uint16_t version;
+    uint16_t state_version;
+    uint32_t boot_frames;
+    uint32_t rom_crc;
+    uint32_t save_ram_crc; // Battery RAM before boot, which the boot may read
+    char core_version[64];
+    uint64_t state_size;
+};
+static_assert(sizeof(WarmStartHeader) == 96, "WarmStartHeader is compared bytewise");
+
+static void fill_header(WarmStartHeader &header, const NES &nes, unsigned int boot_frames)
+{
+    std::memcpy(header.magic, WarmStart::MAGIC, sizeof(header.magic));
+    header.version = WarmStart::VERSION;
+    header.state_version = NES::STATE_VERSION;
+    header.boot_frames = boot_frames;
+    header.rom_crc = nes.rom_crc32();
+    header.save_ram_crc = nes.save_ram_crc32();
+    std::strncpy(header.core_version, NES_CORE_VERSION, sizeof(header.core_version) - 1);
+    header.state_size = nes.state_size();
+}
+
+WarmStart::WarmStart(const std::string &cache_dir, unsigned int boot_frames) :
+    cache_dir(cache_dir), boot_frames(boot_frames)
+{}
+
+// Restores the cached snapshot, or boots from reset and caches one
+void WarmStart::start(NES &nes) const
+{
+    if (!restore(nes))
+    {
+        capture(nes);
+    }
+}
+
+// Must be called on a freshly constructed NES, before it has run
+bool WarmStart::restore(NES &nes) const
+{
+    std::ifstream file(path_for(nes), std::ios::binary);
+    if (!file.is_open()) return false;
+
+    WarmStartHeader expected{};
+    fill_header(expected, nes, boot_frames);
+    WarmStartHeader header{};
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || std::memcmp(&header, &expected, sizeof(header)) != 0)
+    {
+        return false;
+    }
+
+    std::vector<uint8_t> state(header.state_size);
+    file.read(reinterpret_cast<char*>(state.data()), state.size());
+    if (!file) return false;
+
+    nes.load_state(state.data(), state.size());
+    nes.set_frame(boot_frames);
+    return true;
+}
+
+// Boots with no input held and writes the snapshot. The header is taken
+// first since booting may change battery RAM.
+void WarmStart::capture(NES &nes) const
+{
+    WarmStartHeader header{};
+    fill_header(header, nes, boot_frames);
+
+    nes.reset();
+    nes.fast_forward(boot_frames);
+    std::vector<uint8_t> state(nes.state_size());
+    nes.save_state(state.data(), state.size());
+
+    fs::create_directories(cache_dir);
+    const std::string path = path_for(nes);
+    const std::string temp_path = path + ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            throw std::runtime_error("Failed to write warm-start snapshot: " + temp_path);
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(state.data()), state.size());
+        if (!file)
+        {
+            throw std::runtime_error("Failed to write warm-start snapshot: " + temp_path);
+        }
+    }
+    fs::rename(temp_path, path);
+}
+
+// One file per game and boot length; other keys are checked in the header
+// so a stale snapshot is simply overwritten.
+std::string WarmStart::path_for(const NES &nes) const
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%08x-%u.warm", nes.rom_crc32(), boot_frames);
+    return (fs::path(cache_dir) / name).string();
+}
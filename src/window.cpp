@@ -1,12 +1,34 @@
 #include "window.h"
 #include "nes.h"
+#include "controller.h"
+#include "framebuffer.h"
+#include "opcodes.h"
+#include "trace.h"
+
+#include "imgui.h"
+#include "imgui_impl_sdl2.h"
+#include "imgui_impl_sdlrenderer2.h"
 
 #include <iostream>
 #include <array>
+#include <algorithm>
+
+#include <cstdio>
+#include <cstdlib>
 
 Window::Window(int width, int height) :
+    texture(nullptr),
+    pixels(RESOLUTION_X * RESOLUTION_Y),
     width(width),
-    height(height)
+    height(height),
+    show_stats(false),
+    show_debugger(false),
+    breakpoint_input{},
+    show_heatmap(false),
+    rewinding(false),
+    cpu_heat_texture(nullptr),
+    ppu_heat_texture(nullptr),
+    heat_pixels{}
 {
     window = SDL_CreateWindow("CHIP-8",
         SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
@@ -22,35 +44,341 @@ Window::Window(int width, int height) :
     {
         std::cerr << "Failed to create renderer : " << SDL_GetError() << std::endl;
     }
+
+    texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
+        SDL_TEXTUREACCESS_STREAMING, RESOLUTION_X, RESOLUTION_Y);
+    if (texture == NULL)
+    {
+        std::cerr << "Failed to create texture : " << SDL_GetError() << std::endl;
+    }
+
+    ImGui::CreateContext();
+    ImGui::StyleColorsDark();
+    ImGui_ImplSDL2_InitForSDLRenderer(window, renderer);
+    ImGui_ImplSDLRenderer2_Init(renderer);
 }
 
-void Window::draw(const PPU::Display &display)
+// The frame is converted on the CPU and uploaded as one texture, which the
+// renderer scales to the window. ImGui only runs while an overlay is shown.
+void Window::draw(const PPU::Display &display, const FrameStats &stats, Debugger &debugger)
 {
-    draw_grid(display);
+    convert_framebuffer(display, pixels.data());
+    SDL_UpdateTexture(texture, nullptr, pixels.data(), RESOLUTION_X * sizeof(uint32_t));
+    SDL_RenderClear(renderer);
+    SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+    debugger.set_visible(show_debugger);
+    if (show_stats || show_debugger || show_heatmap)
+    {
+        ImGui_ImplSDLRenderer2_NewFrame();
+        ImGui_ImplSDL2_NewFrame();
+        ImGui::NewFrame();
+        if (show_stats) draw_stats(stats);
+        if (show_debugger) draw_debugger(debugger);
+        if (show_heatmap && debugger.cpu_heatmap_ref())
+        {
+            draw_heatmap("CPU bus heatmap", *debugger.cpu_heatmap_ref(), cpu_heat_texture, 256);
+            draw_heatmap("PPU bus heatmap", *debugger.ppu_heatmap_ref(), ppu_heat_texture, 128);
+        }
+        else if (show_heatmap)
+        {
+            ImGui::Begin("Heatmap", &show_heatmap);
+            ImGui::TextUnformatted("Start with --heatmap to record bus accesses.");
+            ImGui::End();
+        }
+        ImGui::Render();
+        ImGui_ImplSDLRenderer2_RenderDrawData(ImGui::GetDrawData(), renderer);
+    }
     SDL_RenderPresent(renderer);
 }
 
-void Window::draw_grid(const PPU::Display &display)
+void Window::draw_stats(const FrameStats &stats)
 {
-    SDL_SetRenderDrawColor(renderer, 0,0,0,255);
-    SDL_RenderClear(renderer);
+    ImGui::SetNextWindowPos(ImVec2(8, 8), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowBgAlpha(0.75f);
+    if (ImGui::Begin("Performance", &show_stats, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoFocusOnAppearing))
+    {
+        ImGui::Text("%.1f fps, %.0f%% speed", stats.fps(), stats.speed() * 100);
+        ImGui::Text("%.2f M CPU cycles/s", stats.cycles_per_second() / 1e6);
+        ImGui::Separator();
+
+        FrameTiming timing = stats.timing();
+        double total = std::max(timing.cpu + timing.ppu + timing.present + timing.idle, 1e-9);
+        std::array<std::pair<const char *, double>, 4> phases = {{
+            {"CPU", timing.cpu}, {"PPU", timing.ppu}, {"Present", timing.present}, {"Idle", timing.idle}
+        }};
+        std::size_t count = phases.size();
+        if (!stats.has_cpu_share())
+        {
+            // No current split measurement, so CPU and PPU are shown together
+            phases = {{
+                {"CPU+PPU", timing.cpu + timing.ppu}, {"Present", timing.present}, {"Idle", timing.idle}
+            }};
+            count = 3;
+        }
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const auto &phase = phases[i];
+            char label[32];
+            std::snprintf(label, sizeof(label), "%.2f ms", phase.second);
+            ImGui::ProgressBar(static_cast<float>(phase.second / total), ImVec2(160, 0), label);
+            ImGui::SameLine();
+            ImGui::TextUnformatted(phase.first);
+        }
+        if (count < phases.size()) ImGui::TextDisabled("CPU/PPU split n/a");
+        ImGui::Separator();
+
+        const float *times = stats.frame_times_ref();
+        float peak = *std::max_element(times, times + FrameStats::HISTORY);
+        ImGui::PlotLines("##frame_times", times, FrameStats::HISTORY, stats.history_offset(),
+            "frame time (ms)", 0.0f, std::max(peak, 1000.0f / 60), ImVec2(240, 60));
+    }
+    ImGui::End();
+}
+
+static void draw_hex_view(const char *id, const uint8_t *data, std::size_t size, uint16_t base)
+{
+    ImGui::BeginChild(id, ImVec2(0, 300));
+    ImGuiListClipper clipper;
+    clipper.Begin(static_cast<int>((size + 15) / 16));
+    while (clipper.Step())
+    {
+        for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row)
+        {
+            char line[80];
+            std::size_t offset = row * 16;
+            int length = std::snprintf(line, sizeof(line), "%04X:", static_cast<unsigned int>(base + offset));
+            for (std::size_t i = offset; i < std::min(offset + 16, size); ++i)
+            {
+                length += std::snprintf(line + length, sizeof(line) - length, " %02X", data[i]);
+            }
+            ImGui::TextUnformatted(line);
+        }
+    }
+    clipper.End();
+    ImGui::EndChild();
+}
 
-    int cols = display.size();
-    int rows = display[0].size();
+// Finds the earliest start in the code window whose instructions decode
+// forward onto pc, so the lines before pc are as likely as possible to be real.
+static uint16_t disassembly_start(const DebugSnapshot &snapshot)
+{
+    for (uint16_t start = 0; start < DebugSnapshot::CODE_BEFORE_PC; ++start)
+    {
+        uint16_t offset = start;
+        while (offset < DebugSnapshot::CODE_BEFORE_PC)
+        {
+            offset += instruction_length(opcode_info(snapshot.code[offset]).mode);
+        }
+        if (offset == DebugSnapshot::CODE_BEFORE_PC)
+        {
+            return start;
+        }
+    }
+    return DebugSnapshot::CODE_BEFORE_PC;
+}
+
+void Window::draw_debugger(Debugger &debugger)
+{
+    const DebugSnapshot &snapshot = *debugger.snapshot_ref();
+    const CPURegisters &regs = snapshot.registers;
+
+    ImGui::SetNextWindowPos(ImVec2(8, 200), ImGuiCond_FirstUseEver);
+    if (ImGui::Begin("CPU", &show_debugger, ImGuiWindowFlags_AlwaysAutoResize))
+    {
+        ImGui::Text("Frame %llu, cycle %llu", static_cast<unsigned long long>(snapshot.frame),
+            static_cast<unsigned long long>(snapshot.cycles));
+        ImGui::Text("PC %04X  A %02X  X %02X  Y %02X  S %02X", regs.pc, regs.a, regs.x, regs.y, regs.s);
+        char flags[9];
+        for (int i = 0; i < 8; ++i)
+        {
+            flags[i] = (regs.p & (0x80 >> i)) ? "NV-BDIZC"[i] : '.';
+        }
+        flags[8] = '\0';
+        ImGui::Text("P  %02X  %s", regs.p, flags);
+        ImGui::Separator();
+
+        if (debugger.is_paused())
+        {
+            if (ImGui::Button("Continue")) debugger.resume();
+        }
+        else if (ImGui::Button("Pause"))
+        {
+            debugger.request_break();
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Clear breakpoints")) debugger.clear_breakpoints();
+        if (ImGui::InputText("Break at", breakpoint_input, sizeof(breakpoint_input),
+            ImGuiInputTextFlags_CharsHexadecimal | ImGuiInputTextFlags_EnterReturnsTrue))
+        {
+            uint16_t addr = static_cast<uint16_t>(std::strtoul(breakpoint_input, nullptr, 16));
+            debugger.set_breakpoint(addr, !debugger.has_breakpoint(addr));
+            breakpoint_input[0] = '\0';
+        }
+    }
+    ImGui::End();
 
-    int square_width = width / cols;
-    int square_height = height / rows;
+    ImGui::SetNextWindowPos(ImVec2(260, 200), ImGuiCond_FirstUseEver);
+    if (ImGui::Begin("Disassembly", &show_debugger, ImGuiWindowFlags_AlwaysAutoResize))
+    {
+        // Clicking a line toggles a breakpoint on it
+        uint16_t offset = disassembly_start(snapshot);
+        for (int line = 0; line < 24 && offset + 3u <= snapshot.code.size(); ++line)
+        {
+            uint16_t addr = snapshot.code_start + offset;
+            std::string text = disassemble(addr, &snapshot.code[offset]);
+            char label[48];
+            std::snprintf(label, sizeof(label), "%c%c %04X  %s",
+                addr == regs.pc ? '>' : ' ', debugger.has_breakpoint(addr) ? '*' : ' ', addr, text.c_str());
+            ImGui::PushID(line);
+            if (ImGui::Selectable(label, addr == regs.pc))
+            {
+                debugger.set_breakpoint(addr, !debugger.has_breakpoint(addr));
+            }
+            ImGui::PopID();
+            offset += instruction_length(opcode_info(snapshot.code[offset]).mode);
+        }
+    }
+    ImGui::End();
 
-    for (int col = 0; col < cols; ++col) {
-        for (int row = 0; row < rows; ++row) {
-            if (display[col][row]) {
-                SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-            } else {
-                SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+    ImGui::SetNextWindowPos(ImVec2(8, 480), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowSize(ImVec2(420, 360), ImGuiCond_FirstUseEver);
+    if (ImGui::Begin("Memory", &show_debugger))
+    {
+        if (ImGui::BeginTabBar("memory"))
+        {
+            if (ImGui::BeginTabItem("CPU RAM"))
+            {
+                draw_hex_view("cpu_mem", snapshot.cpu_mem.data(), snapshot.cpu_mem.size(), 0x0000);
+                ImGui::EndTabItem();
+            }
+            if (ImGui::BeginTabItem("VRAM"))
+            {
+                draw_hex_view("vram", snapshot.vram.data(), snapshot.vram.size(), 0x2000);
+                ImGui::EndTabItem();
             }
+            if (ImGui::BeginTabItem("OAM"))
+            {
+                draw_hex_view("oam", snapshot.oam.data(), snapshot.oam.size(), 0x00);
+                ImGui::EndTabItem();
+            }
+            if (ImGui::BeginTabItem("Palette"))
+            {
+                draw_hex_view("palette", snapshot.palette.data(), snapshot.palette.size(), 0x3F00);
+                ImGui::EndTabItem();
+            }
+            ImGui::EndTabBar();
+        }
+    }
+    ImGui::End();
+}
+
+// Brightness by bit length of the count, so hot and cold areas both stay visible
+static uint32_t heat_level(uint32_t count, uint32_t max_count)
+{
+    unsigned int bits = count ? 32 - __builtin_clz(count) : 0;
+    unsigned int max_bits = max_count ? 32 - __builtin_clz(max_count) : 1;
+    return bits * 255 / max_bits;
+}
+
+// One pixel per address, `columns` addresses to a row: red for writes, green
+// for reads and blue for opcode fetches
+void Window::draw_heatmap(const char *title, const AccessHeatmap &heatmap, SDL_Texture *&texture, int columns)
+{
+    int rows = static_cast<int>(heatmap.get_size()) / columns;
+    if (!texture)
+    {
+        texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, columns, rows);
+    }
+
+    const uint32_t *reads = heatmap.counts_ref(HEAT_READ);
+    const uint32_t *writes = heatmap.counts_ref(HEAT_WRITE);
+    const uint32_t *fetches = heatmap.counts_ref(HEAT_FETCH);
+    uint32_t max_read = heatmap.max_count(HEAT_READ);
+    uint32_t max_write = heatmap.max_count(HEAT_WRITE);
+    uint32_t max_fetch = heatmap.max_count(HEAT_FETCH);
+    heat_pixels.resize(heatmap.get_size());
+    for (std::size_t i = 0; i < heat_pixels.size(); ++i)
+    {
+        heat_pixels[i] = 0xFF000000 | heat_level(writes[i], max_write) << 16
+            | heat_level(reads[i], max_read) << 8 | heat_level(fetches[i], max_fetch);
+    }
+    SDL_UpdateTexture(texture, nullptr, heat_pixels.data(), columns * sizeof(uint32_t));
 
-            SDL_Rect rect = { col * square_width, row * square_height, square_width, square_height };
-            SDL_RenderFillRect(renderer, &rect);
+    if (ImGui::Begin(title, &show_heatmap, ImGuiWindowFlags_AlwaysAutoResize))
+    {
+        constexpr float SCALE = 2.0f;
+        ImVec2 origin = ImGui::GetCursorScreenPos();
+        ImGui::Image(reinterpret_cast<ImTextureID>(texture), ImVec2(columns * SCALE, rows * SCALE));
+        if (ImGui::IsItemHovered())
+        {
+            ImVec2 mouse = ImGui::GetMousePos();
+            int column = std::clamp(static_cast<int>((mouse.x - origin.x) / SCALE), 0, columns - 1);
+            int row = std::clamp(static_cast<int>((mouse.y - origin.y) / SCALE), 0, rows - 1);
+            int addr = row * columns + column;
+            ImGui::SetTooltip("$%04X: %u reads, %u writes, %u fetches", addr, reads[addr], writes[addr], fetches[addr]);
+        }
+    }
+    ImGui::End();
+}
+
+// Pumps SDL events and samples the keyboard. Returns false once the window is closed.
+bool Window::poll_input(uint8_t &buttons)
+{
+    SDL_Event event;
+    while (SDL_PollEvent(&event))
+    {
+        ImGui_ImplSDL2_ProcessEvent(&event);
+        if (event.type == SDL_QUIT)
+        {
+            return false;
+        }
+        if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F1)
+        {
+            show_stats = !show_stats;
+        }
+        if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F2)
+        {
+            show_debugger = !show_debugger;
+        }
+        if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F3)
+        {
+            Tracer::instance().write();
+        }
+        if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F4)
+        {
+            show_heatmap = !show_heatmap;
         }
     }
+
+    // Keys typed into a debugger field are not game input. ImGui only updates
+    // WantCaptureKeyboard while a panel is drawn.
+    buttons = 0;
+    rewinding = false;
+    bool panels = show_stats || show_debugger || show_heatmap;
+    if (panels && ImGui::GetIO().WantCaptureKeyboard)
+    {
+        return true;
+    }
+
+    const uint8_t *keys = SDL_GetKeyboardState(nullptr);
+    rewinding = keys[SDL_SCANCODE_BACKSPACE];
+    if (keys[SDL_SCANCODE_X]) buttons |= ControllerButton::BUTTON_A;
+    if (keys[SDL_SCANCODE_Z]) buttons |= ControllerButton::BUTTON_B;
+    if (keys[SDL_SCANCODE_RSHIFT]) buttons |= ControllerButton::BUTTON_SELECT;
+    if (keys[SDL_SCANCODE_RETURN]) buttons |= ControllerButton::BUTTON_START;
+    if (keys[SDL_SCANCODE_UP]) buttons |= ControllerButton::BUTTON_UP;
+    if (keys[SDL_SCANCODE_DOWN]) buttons |= ControllerButton::BUTTON_DOWN;
+    if (keys[SDL_SCANCODE_LEFT]) buttons |= ControllerButton::BUTTON_LEFT;
+    if (keys[SDL_SCANCODE_RIGHT]) buttons |= ControllerButton::BUTTON_RIGHT;
+    return true;
+}
+
+bool Window::rewind_held() const
+{
+    return rewinding;
+}
+
+bool Window::stats_visible() const
+{
+    return show_stats;
 }
\ No newline at end of file